@@ -0,0 +1,529 @@
+#include "bench.hpp"
+#include <complex>
+#include "CosmosLogic.hpp"
+#include "SlewLFOCore.hpp"
+
+// Aliasing against CPU for each oversampling setting (factor and filter quality) of COSMOS and SlewLFO.
+//
+// The COSMOS logic kernels (OR, AND, XOR through-zero clipper) and the SlewLFO core (slew mode, fast rate) are run
+// through the same oversampling chain as in the modules, with a sweep of sine inputs, and for comparison through
+// VariableOversampling with the Butterworth AAFilter cascade of each order (quality "butterN"). Inputs are sampled
+// coherently (an odd number of periods over the analysis length) so the output spectrum only has the harmonics of the
+// sine and aliases, and these never share a bin. Only the band up to the oversamplers' passband edge (19.2kHz) is analysed.
+// For each setting this reports
+//   - aliasing: power of the non-harmonic components relative to the ideal (non-aliased) output, worst case of the sweep
+//   - SNR at each sweep frequency: power of the ideal output, relative to everything else (aliases, and errors in the
+//     harmonics' amplitudes, e.g. from the filters' passband or the SlewLFO input being held over oversampled steps)
+//   - the cost of the chain in ns per frame (COSMOS kernels run 4 channels at a time, SlewLFO 1 channel)
+// COSMOS' logic kernels are also run with antiderivative anti-aliasing at the base rate (quality "adaa").
+// Settings marked with * are Pareto optimal: no other setting has a better mean SNR for the same or less CPU.
+//
+// The theoretical response of the halfband anti-aliasing filters is then printed next to the measured one.
+//
+// Finally the ADAA kernels are checked against their definition: where neither x - y nor x + y changes sign over the
+// last three inputs each kernel is linear, so its output must be the triangularly filtered kernel output. The
+// benchmark exits with an error if not.
+
+static const float sampleRate = 48000.f;
+static const int numFrames = 1 << 14;
+static const float bandLimit = 0.4f * sampleRate;
+// sine sweep frequencies (Hz), one per float_4 lane for the COSMOS kernels
+static const int numSweep = 4;
+static const float sweep[numSweep] = {250.f, 1000.f, 4000.f, 10000.f};
+// the ideal output is computed from one period of the input sampled this finely
+static const int referenceLength = 1 << 14;
+
+static const char* qualityNames[chowdsp::NUM_QUALITIES] = {"eco", "standard", "high", "low-latency"};
+
+/** Odd DFT bin nearest to a frequency: odd bins are coprime with the (power of two) length, so aliases never land on harmonics */
+static int sweepBin(float freq) {
+	return 2 * (int)(freq / sampleRate * numFrames / 2) + 1;
+}
+
+/** In place radix-2 FFT, the size must be a power of two */
+static void fft(std::vector<std::complex<double>>& x) {
+	const int n = x.size();
+	for (int i = 1, j = 0; i < n; i++) {
+		int bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j)
+			std::swap(x[i], x[j]);
+	}
+	for (int len = 2; len <= n; len <<= 1) {
+		const std::complex<double> step = std::polar(1.0, -2.0 * M_PI / len);
+		for (int i = 0; i < n; i += len) {
+			std::complex<double> w = 1.0;
+			for (int k = 0; k < len / 2; k++) {
+				const std::complex<double> u = x[i + k];
+				const std::complex<double> v = x[i + k + len / 2] * w;
+				x[i + k] = u + v;
+				x[i + k + len / 2] = u - v;
+				w *= step;
+			}
+		}
+	}
+}
+
+/** Amplitude of each sinusoidal component (bin) of one period of a real signal, up to half its length */
+static std::vector<double> amplitudes(const std::vector<double>& signal) {
+	std::vector<std::complex<double>> x(signal.begin(), signal.end());
+	fft(x);
+	std::vector<double> a(x.size() / 2);
+	for (size_t b = 0; b < a.size(); b++)
+		a[b] = 2.0 * std::abs(x[b]) / x.size();
+	return a;
+}
+
+struct Quality {
+	double aliasing; // dB
+	double snr; // dB
+};
+
+/**
+ * Compares the steady state `output` (`bin` periods of the test sine, over `numFrames`) to the ideal output, given
+ * by the amplitudes of its harmonics (`reference[k]` for harmonic k). DC is ignored.
+ */
+static Quality measure(const std::vector<double>& output, int bin, const std::vector<double>& reference) {
+	const std::vector<double> a = amplitudes(output);
+	const int numBins = bandLimit / sampleRate * numFrames;
+
+	double signal = 0.0, error = 0.0, aliasing = 0.0;
+	for (int b = 1; b <= numBins; b++) {
+		if (b % bin == 0) {
+			const double ideal = reference[b / bin];
+			signal += 0.5 * ideal * ideal;
+			error += 0.5 * (a[b] - ideal) * (a[b] - ideal);
+		}
+		else {
+			aliasing += 0.5 * a[b] * a[b];
+		}
+	}
+
+	Quality q;
+	q.aliasing = 10.0 * std::log10((aliasing + 1e-30) / signal);
+	q.snr = 10.0 * std::log10(signal / (error + aliasing + 1e-30));
+	return q;
+}
+
+// Result::quality of the antiderivative anti-aliased kernels
+static const int ADAA = -2;
+
+struct Result {
+	int oversamplingIndex;
+	int quality; // -1 without oversampling or with the Butterworth filters, ADAA for antiderivative anti-aliasing
+	double ns;
+	Quality q[numSweep]; // for each sweep frequency
+	int butterworthOrder = 0; // order of the AAFilter cascade, 0 for the halfband oversamplers
+
+	double worstAliasing() const {
+		double worst = -1e30;
+		for (int i = 0; i < numSweep; i++)
+			worst = std::max(worst, q[i].aliasing);
+		return worst;
+	}
+
+	double meanSNR() const {
+		double sum = 0.0;
+		for (int i = 0; i < numSweep; i++)
+			sum += q[i].snr;
+		return sum / numSweep;
+	}
+};
+
+static void printHeader() {
+	std::printf("%-8s %-6s %-9s %9s %9s", "kernel", "ratio", "quality", "ns/frame", "alias dB");
+	for (float freq : sweep)
+		std::printf("  SNR@%-5.0f", freq);
+	std::printf("\n");
+}
+
+/** Prints the results of a kernel, marking the Pareto optimal settings (by mean SNR over the sweep) */
+static void report(const char* kernel, const std::vector<Result>& results) {
+	for (const Result& r : results) {
+		bool dominated = false;
+		for (const Result& other : results) {
+			dominated |= (other.ns <= r.ns && other.meanSNR() > r.meanSNR()) || (other.ns < r.ns && other.meanSNR() >= r.meanSNR());
+		}
+		char quality[16];
+		if (r.butterworthOrder)
+			std::snprintf(quality, sizeof(quality), "butter%d", r.butterworthOrder);
+		else
+			std::snprintf(quality, sizeof(quality), "%s", r.quality == ADAA ? "adaa" : r.quality < 0 ? "-" : qualityNames[r.quality]);
+		std::printf("%-8s x%-5d %-9s %9.2f %9.1f", kernel, 1 << r.oversamplingIndex, quality, r.ns, r.worstAliasing());
+		for (int i = 0; i < numSweep; i++)
+			std::printf(" %9.1f", r.q[i].snr);
+		std::printf(" %s\n", dominated ? "" : "*");
+	}
+}
+
+/** Calls `f(oversamplingIndex, quality)` for each setting, quality is -1 without oversampling (where it doesn't matter) */
+template <typename F>
+static void forEachSetting(F f) {
+	f(0, -1);
+	for (int idx = 1; idx < 5; idx++) {
+		for (int q = 0; q < chowdsp::NUM_QUALITIES; q++) {
+			f(idx, q);
+		}
+	}
+}
+
+/** Calls `f(oversamplingIndex, std::integral_constant<int, filtN>())` for each factor and AAFilter order (2 * filtN) */
+template <typename F>
+static void forEachButterworth(F f) {
+	for (int idx = 1; idx < 5; idx++) {
+		f(idx, std::integral_constant<int, 2>());
+		f(idx, std::integral_constant<int, 4>());
+		f(idx, std::integral_constant<int, 6>());
+	}
+}
+
+template <typename Bank>
+static void configure(Bank& bank, int oversamplingIndex, int quality) {
+	bank.setQuality((chowdsp::FilterQuality) std::max(quality, 0));
+	bank.setOversamplingIndex(oversamplingIndex);
+}
+
+template <int filtN, typename T>
+static void configure(chowdsp::VariableOversampling<filtN, T>& os, int oversamplingIndex, int /*quality*/) {
+	os.reset(sampleRate);
+	os.setOversamplingIndex(oversamplingIndex);
+}
+
+// single signal access to a halfband bank or a VariableOversampling, for the SlewLFO chains
+template <int K, int filtN, typename T>
+static T* getOSBuffer(chowdsp::HalfbandDownsamplingBank<K, filtN, T>& os) {
+	return os.getOSBuffer(0);
+}
+
+template <int filtN, typename T>
+static T* getOSBuffer(chowdsp::VariableOversampling<filtN, T>& os) {
+	return os.getOSBuffer();
+}
+
+template <int K, int filtN, typename T>
+static T downsample(chowdsp::HalfbandDownsamplingBank<K, filtN, T>& os) {
+	T y;
+	os.downsample(&y);
+	return y;
+}
+
+template <int filtN, typename T>
+static T downsample(chowdsp::VariableOversampling<filtN, T>& os) {
+	return os.downsample();
+}
+
+/**
+ * A COSMOS logic kernel with x a 5V sine (a different sweep frequency in each lane) and y at 2V, as in `Cosmos::processChannels()`.
+ * `adaaKernel(adaa, x, y)` gives the same kernel's output from a `cosmos::LogicADAA`.
+ */
+template <typename Kernel, typename ADAAKernel>
+static void runCosmos(const char* name, Kernel kernel, ADAAKernel adaaKernel) {
+	// X and Y are upsampled together, and the output downsampled, as in `Cosmos::Engine`
+	typedef chowdsp::HalfbandUpsamplingBank<2, 6, simd::float_4> Upsampler;
+	typedef chowdsp::HalfbandDownsamplingBank<1, 6, simd::float_4> Downsampler;
+	static_assert(numSweep == 4, "one sweep frequency per lane");
+
+	int bins[numSweep];
+	std::vector<simd::float_4> x(numFrames);
+	for (int lane = 0; lane < numSweep; lane++) {
+		bins[lane] = sweepBin(sweep[lane]);
+		for (int n = 0; n < numFrames; n++)
+			x[n][lane] = 5.0 * std::sin(2.0 * M_PI * bins[lane] * n / numFrames);
+	}
+	const simd::float_4 y = 2.f;
+
+	// the kernels are memoryless, so the ideal output is the same for all frequencies
+	std::vector<double> period(referenceLength);
+	for (int n = 0; n < referenceLength; n++)
+		period[n] = kernel(simd::float_4(5.0 * std::sin(2.0 * M_PI * n / referenceLength)), y)[0];
+	const std::vector<double> reference = amplitudes(period);
+
+	auto measureLanes = [&](const std::vector<simd::float_4>& out, Result& r) {
+		for (int lane = 0; lane < numSweep; lane++) {
+			std::vector<double> output(numFrames);
+			for (int n = 0; n < numFrames; n++)
+				output[n] = out[n][lane];
+			r.q[lane] = measure(output, bins[lane], reference);
+		}
+	};
+
+	std::vector<Result> results;
+	forEachSetting([&](int oversamplingIndex, int quality) {
+		Upsampler xyOS;
+		Downsampler outOS;
+		configure(xyOS, oversamplingIndex, quality);
+		configure(outOS, oversamplingIndex, quality);
+		const int ratio = xyOS.getOversamplingRatio();
+
+		// the output of the last (steady state) run is analysed, the input being exactly periodic over numFrames
+		std::vector<simd::float_4> out(numFrames);
+		Result r = {oversamplingIndex, quality, 0.0, {}};
+		r.ns = bench::nsPerFrame([&]() {
+			for (int n = 0; n < numFrames; n++) {
+				const simd::float_4 xy[2] = {x[n], y};
+				xyOS.upsample(xy);
+				const simd::float_4* xBuffer = xyOS.getOSBuffer(0);
+				const simd::float_4* yBuffer = xyOS.getOSBuffer(1);
+				simd::float_4* outBuffer = outOS.getOSBuffer(0);
+				for (int i = 0; i < ratio; i++)
+					outBuffer[i] = kernel(xBuffer[i], yBuffer[i]);
+				outOS.downsample(&out[n]);
+			}
+		}, numFrames);
+
+		measureLanes(out, r);
+		results.push_back(r);
+	});
+
+	// X and Y each through a Butterworth VariableOversampling, and the output through a third
+	forEachButterworth([&](int oversamplingIndex, auto order) {
+		constexpr int filtN = decltype(order)::value;
+		chowdsp::VariableOversampling<filtN, simd::float_4> xOS, yOS, outOS;
+		configure(xOS, oversamplingIndex, -1);
+		configure(yOS, oversamplingIndex, -1);
+		configure(outOS, oversamplingIndex, -1);
+		const int ratio = outOS.getOversamplingRatio();
+
+		std::vector<simd::float_4> out(numFrames);
+		Result r = {oversamplingIndex, -1, 0.0, {}, 2 * filtN};
+		r.ns = bench::nsPerFrame([&]() {
+			for (int n = 0; n < numFrames; n++) {
+				xOS.upsample(x[n]);
+				yOS.upsample(y);
+				const simd::float_4* xBuffer = xOS.getOSBuffer();
+				const simd::float_4* yBuffer = yOS.getOSBuffer();
+				simd::float_4* outBuffer = outOS.getOSBuffer();
+				for (int i = 0; i < ratio; i++)
+					outBuffer[i] = kernel(xBuffer[i], yBuffer[i]);
+				out[n] = outOS.downsample();
+			}
+		}, numFrames);
+
+		measureLanes(out, r);
+		results.push_back(r);
+	});
+
+	{
+		cosmos::LogicADAA<simd::float_4> adaa;
+		std::vector<simd::float_4> out(numFrames);
+		Result r = {0, ADAA, 0.0, {}};
+		r.ns = bench::nsPerFrame([&]() {
+			for (int n = 0; n < numFrames; n++)
+				out[n] = adaaKernel(adaa, x[n], y);
+		}, numFrames);
+
+		measureLanes(out, r);
+		results.push_back(r);
+	}
+	report(name, results);
+}
+
+/**
+ * The SlewLFO core in slew mode at the fast rate (without capacitor), following a 5V sine, as in `SlewLFO::process()`,
+ * for one setting of a single channel downsampler `Downsampler` (a halfband bank as in `SlewLFO`, or a VariableOversampling)
+ */
+template <typename Downsampler>
+static Result runSlewLFOSetting(Result r) {
+	// fast rate without capacitor, rise/fall at 30% (so the sine is slew limited from ~200Hz), linear curve
+	const double slewMin = 10. / 200e-3, slewMax = 10. / 200e-6;
+	const double rise = 3., fall = 3.;
+	const double shapeScale = 1 / 10., shape = 0.;
+
+	for (int i = 0; i < numSweep; i++) {
+		const int bin = sweepBin(sweep[i]);
+
+		// the slew limiter has memory: the ideal output is the steady state of a finely sampled simulation
+		std::vector<double> period(referenceLength);
+		double idealOut = 0.;
+		bool idealFalling = false;
+		const double idealStep = numFrames / (bin * sampleRate) / referenceLength;
+		for (int p = 0; p < 8; p++) {
+			for (int n = 0; n < referenceLength; n++) {
+				const double in = 5.0 * std::sin(2.0 * M_PI * n / referenceLength);
+				slewlfo::processStep(idealOut, idealFalling, false, in, rise, fall, slewMin, slewMax, shapeScale, shape, idealStep);
+				period[n] = idealOut;
+			}
+		}
+		const std::vector<double> reference = amplitudes(period);
+
+		std::vector<double> input(numFrames);
+		for (int n = 0; n < numFrames; n++)
+			input[n] = 5.0 * std::sin(2.0 * M_PI * bin * n / numFrames);
+
+		Downsampler os;
+		configure(os, r.oversamplingIndex, r.quality);
+		const int ratio = os.getOversamplingRatio();
+		const double sampleTimeOversample = 1.0 / sampleRate / ratio;
+
+		std::vector<double> output(numFrames);
+		double out = 0.;
+		bool falling = false;
+		r.ns += bench::nsPerFrame([&]() {
+			for (int n = 0; n < numFrames; n++) {
+				// the input is held over the oversampled steps
+				double* outBuffer = getOSBuffer(os);
+				for (int i = 0; i < ratio; i++) {
+					slewlfo::processStep(out, falling, false, input[n], rise, fall, slewMin, slewMax, shapeScale, shape, sampleTimeOversample);
+					outBuffer[i] = out;
+				}
+				output[n] = downsample(os);
+			}
+		}, numFrames) / numSweep;
+
+		r.q[i] = measure(output, bin, reference);
+	}
+	return r;
+}
+
+static void runSlewLFO() {
+	std::vector<Result> results;
+	forEachSetting([&](int oversamplingIndex, int quality) {
+		// the downsampler of `SlewLFO`, for one channel
+		results.push_back(runSlewLFOSetting<chowdsp::HalfbandDownsamplingBank<1, 6, double>>({oversamplingIndex, quality, 0.0, {}}));
+	});
+	forEachButterworth([&](int oversamplingIndex, auto order) {
+		constexpr int filtN = decltype(order)::value;
+		results.push_back(runSlewLFOSetting<chowdsp::VariableOversampling<filtN, double>>({oversamplingIndex, -1, 0.0, {}, 2 * filtN}));
+	});
+	report("SlewLFO", results);
+}
+
+/** Measured response of the downsampling filters at frequency bin/length (normalised to the base sample rate) */
+template <int ratio>
+static double measureResponse(chowdsp::FilterQuality quality, int bin, int length) {
+	chowdsp::HalfbandOversampling<ratio, 6, double> os;
+	os.setQuality(quality);
+	os.reset(sampleRate);
+
+	// the tone aliases to this bin at the base rate
+	int aliasBin = bin % length;
+	aliasBin = std::min(aliasBin, length - aliasBin);
+
+	std::complex<double> sum = 0.0;
+	for (int pass = 0; pass < 2; pass++) {
+		sum = 0.0;
+		for (int n = 0; n < length; n++) {
+			double* osBuffer = os.getOSBuffer();
+			for (int k = 0; k < ratio; k++)
+				osBuffer[k] = std::cos(2.0 * M_PI * bin * (double)(n * ratio + k) / ((double) length * ratio));
+			sum += os.downsample() * std::polar(1.0, -2.0 * M_PI * aliasBin * n / length);
+		}
+	}
+	return 2.0 * std::abs(sum) / length;
+}
+
+template <int ratio>
+static void printResponse() {
+	const int length = 4096;
+	// passband (up to 0.4), transition band, and stopband up to the oversampled Nyquist frequency
+	const double freqs[] = {0.1, 0.3, 0.4, 0.45, 0.55, 0.6, 0.9, 1.9, 3.9, 7.9};
+	for (double f : freqs) {
+		if (f >= ratio / 2.0)
+			break;
+		const int bin = (int)(f * length) | 1;
+		std::printf("x%-5d %9.0f", ratio, bin * sampleRate / length);
+		for (int q = 0; q < chowdsp::NUM_QUALITIES; q++) {
+			const double theory = chowdsp::HalfbandOversampling<ratio, 6, double>::getFrequencyResponse((chowdsp::FilterQuality) q, (double) bin / length);
+			const double measured = measureResponse<ratio>((chowdsp::FilterQuality) q, bin, length);
+			std::printf("   %7.1f %7.1f", 20.0 * std::log10(theory), 20.0 * std::log10(measured));
+		}
+		std::printf("\n");
+	}
+}
+
+/**
+    Checks `cosmos::LogicADAA` against the triangular filter (weights 1/6, 2/3, 1/6) of each kernel's output, on random
+    inputs, wherever the kernels are linear over the last three inputs. Returns the number of mismatches.
+*/
+static int checkADAA() {
+	typedef simd::float_4 T;
+	cosmos::LogicADAA<T> adaa;
+	T xHistory[2] = {}, yHistory[2] = {};
+	std::srand(1);
+	auto random = []() {
+		return 10.f * std::rand() / RAND_MAX - 5.f;
+	};
+
+	int mismatches = 0;
+	for (int n = 0; n < numFrames; n++) {
+		T x, y;
+		for (int lane = 0; lane < 4; lane++) {
+			x[lane] = random();
+			// y alternates around a level, so that some stretches have no crossings
+			y[lane] = (lane == 0) ? ((n & 1) ? 1.f : -1.f) : random() * (lane / 4.f);
+		}
+		T out[3];
+		adaa.process(x, y, out[0], out[1], out[2]);
+
+		const T xs[3] = {xHistory[0], xHistory[1], x};
+		const T ys[3] = {yHistory[0], yHistory[1], y};
+		xHistory[0] = xHistory[1];
+		xHistory[1] = x;
+		yHistory[0] = yHistory[1];
+		yHistory[1] = y;
+		if (n < 2)
+			continue;
+
+		for (int lane = 0; lane < 4; lane++) {
+			bool linear = true;
+			float expected[3] = {};
+			for (int k = 0; k < 3; k++) {
+				const float xk = xs[k][lane], yk = ys[k][lane];
+				linear &= ((xk - yk) > 0) == ((xs[1][lane] - ys[1][lane]) > 0) && ((xk + yk) > 0) == ((xs[1][lane] + ys[1][lane]) > 0);
+				const float weight = (k == 1) ? 2.f / 3.f : 1.f / 6.f;
+				expected[0] += weight * cosmos::logicOr(xk, yk);
+				expected[1] += weight * cosmos::logicAnd(xk, yk);
+				expected[2] += weight * cosmos::logicXor(xk, yk);
+			}
+			if (!linear)
+				continue;
+			for (int k = 0; k < 3; k++) {
+				if (std::abs(out[k][lane] - expected[k]) > 1e-4f) {
+					if (mismatches++ < 8)
+						std::printf("ADAA mismatch at frame %d lane %d kernel %d: %f, expected %f\n", n, lane, k, out[k][lane], expected[k]);
+				}
+			}
+		}
+	}
+	return mismatches;
+}
+
+int main() {
+	printHeader();
+	typedef cosmos::LogicADAA<simd::float_4> ADAA;
+	runCosmos("OR", [](const simd::float_4& x, const simd::float_4& y) {
+		return cosmos::logicOr(x, y);
+	}, [](ADAA& adaa, const simd::float_4& x, const simd::float_4& y) {
+		simd::float_4 orOut, andOut, xorOut;
+		adaa.process(x, y, orOut, andOut, xorOut);
+		return orOut;
+	});
+	runCosmos("AND", [](const simd::float_4& x, const simd::float_4& y) {
+		return cosmos::logicAnd(x, y);
+	}, [](ADAA& adaa, const simd::float_4& x, const simd::float_4& y) {
+		simd::float_4 orOut, andOut, xorOut;
+		adaa.process(x, y, orOut, andOut, xorOut);
+		return andOut;
+	});
+	runCosmos("XOR", [](const simd::float_4& x, const simd::float_4& y) {
+		return cosmos::logicXor(x, y);
+	}, [](ADAA& adaa, const simd::float_4& x, const simd::float_4& y) {
+		simd::float_4 orOut, andOut, xorOut;
+		adaa.process(x, y, orOut, andOut, xorOut);
+		return xorOut;
+	});
+	runSlewLFO();
+
+	std::printf("\nanti-aliasing filter response (dB), theoretical and measured, at %.0fHz\n", sampleRate);
+	std::printf("%-6s %9s   %-15s   %-15s   %-15s   %-15s\n", "ratio", "freq Hz", "eco", "standard", "high", "low-latency");
+	printResponse<2>();
+	printResponse<4>();
+	printResponse<8>();
+	printResponse<16>();
+
+	const int mismatches = checkADAA();
+	std::printf("\nADAA check against the triangularly filtered kernels: %s\n", mismatches ? "FAILED" : "ok");
+	return mismatches ? 1 : 0;
+}
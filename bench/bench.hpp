@@ -0,0 +1,59 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include <vector>
+#include "plugin.hpp"
+#include "ChowDSP.hpp"
+
+// Helpers shared by the standalone benchmarks, which only use header-only DSP code (Rack's headers, but not its engine or GUI).
+namespace bench {
+
+/** Stops the compiler from optimising away a computed value */
+template <typename T>
+inline void doNotOptimise(const T& value) {
+	asm volatile("" : : "m"(value) : "memory");
+}
+
+/**
+ * Runs `f` (which processes `numFrames` frames) a few times, and returns the best time in ns per frame.
+ * Not inlined, so that each case is compiled on its own, and its timing doesn't depend on what else is benchmarked.
+ */
+template <typename F>
+__attribute__((noinline)) double nsPerFrame(F&& f, int numFrames, int repeats = 7) {
+	// warm up caches and branch predictors
+	f();
+
+	double best = 1e30;
+	for (int r = 0; r < repeats; r++) {
+		const auto start = std::chrono::steady_clock::now();
+		f();
+		const auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / numFrames);
+	}
+	return best;
+}
+
+/** Deterministic test signal in the ±7V range, precomputed so that generating it isn't timed */
+template <typename T>
+std::vector<T> makeTestSignal(int numFrames) {
+	std::vector<T> signal(numFrames);
+	for (int n = 0; n < numFrames; n++) {
+		signal[n] = T(5.f * std::sin(0.0131f * n) + 2.f * std::sin(0.173f * n));
+	}
+	return signal;
+}
+
+/** Human readable name of the sample types benchmarked */
+template <typename T> inline const char* typeName();
+template <> inline const char* typeName<float>() {
+	return "float";
+}
+template <> inline const char* typeName<double>() {
+	return "double";
+}
+template <> inline const char* typeName<simd::float_4>() {
+	return "float_4";
+}
+
+} // namespace bench
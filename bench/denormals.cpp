@@ -0,0 +1,88 @@
+#include "bench.hpp"
+
+// Cost over time of filters fed an impulse followed by silence. As the filter states decay they become denormal,
+// which (without FTZ/DAZ) is very slow. The oversamplers flush tiny states to zero, so their cost should stay flat.
+// Rows: the bare AAFilter cascade (no protection), the same under ScopedNoDenormals, and both oversamplers.
+
+static const int ratio = 4;
+static const int windowFrames = 1 << 13;
+static const int numWindows = 24;
+
+// times each window of `windowFrames` frames after the impulse (not best-of, as the state only decays once)
+template <typename F>
+static void timeWindows(const char* name, const char* type, F&& processFrame) {
+	std::printf("%-24s %-8s", name, type);
+	for (int w = 0; w < numWindows; w++) {
+		const auto start = std::chrono::steady_clock::now();
+		for (int n = 0; n < windowFrames; n++) {
+			processFrame(w == 0 && n == 0 ? 10.f : 0.f);
+		}
+		const auto end = std::chrono::steady_clock::now();
+		if (w % 3 == 0) {
+			std::printf(" %7.1f", std::chrono::duration<double, std::nano>(end - start).count() / windowFrames);
+		}
+	}
+	std::printf("\n");
+}
+
+template <typename T>
+static void run() {
+	const char* type = bench::typeName<T>();
+	{
+		chowdsp::AAFilter<6, T> aiFilter, aaFilter;
+		aiFilter.reset(48000.f, ratio);
+		aaFilter.reset(48000.f, ratio);
+		timeWindows("AAFilter (unprotected)", type, [&](float x) {
+			T y = 0.f;
+			for (int k = 0; k < ratio; k++)
+				y = aaFilter.process(aiFilter.process(k == 0 ? T(x) : T(0.f)));
+			bench::doNotOptimise(y);
+		});
+	}
+	{
+		chowdsp::ScopedNoDenormals noDenormals;
+		chowdsp::AAFilter<6, T> aiFilter, aaFilter;
+		aiFilter.reset(48000.f, ratio);
+		aaFilter.reset(48000.f, ratio);
+		timeWindows("AAFilter (FTZ/DAZ)", type, [&](float x) {
+			T y = 0.f;
+			for (int k = 0; k < ratio; k++)
+				y = aaFilter.process(aiFilter.process(k == 0 ? T(x) : T(0.f)));
+			bench::doNotOptimise(y);
+		});
+	}
+	{
+		chowdsp::Oversampling<ratio, 6, T> os;
+		os.reset(48000.f);
+		timeWindows("Oversampling", type, [&](float x) {
+			os.upsample(x);
+			bench::doNotOptimise(os.downsample());
+		});
+	}
+	{
+		chowdsp::HalfbandOversampling<ratio, 6, T> os;
+		os.reset(48000.f);
+		timeWindows("HalfbandOversampling", type, [&](float x) {
+			os.upsample(x);
+			bench::doNotOptimise(os.downsample());
+		});
+	}
+}
+
+int main() {
+#if defined(__SSE__)
+	// executables built with -funsafe-math-optimizations enable FTZ/DAZ at startup (plugins, as shared libraries, don't),
+	// so turn them off to see the unprotected cost
+	_mm_setcsr(_mm_getcsr() & ~0x8040);
+#endif
+	std::printf("ns/frame at x%d, in windows of %d frames after an impulse\n", ratio, windowFrames);
+	std::printf("%-24s %-8s", "", "frames:");
+	for (int w = 0; w < numWindows; w += 3) {
+		std::printf(" %6dk", w * windowFrames / 1024);
+	}
+	std::printf("\n");
+	run<float>();
+	run<double>();
+	run<simd::float_4>();
+	return 0;
+}
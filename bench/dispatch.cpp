@@ -0,0 +1,81 @@
+#include "bench.hpp"
+
+// Per-call cost of the VariableOversampling dispatch. Compares a virtual call through BaseOversampling
+// (how VariableOversampling used to dispatch) with the compile-time switch over the concrete oversamplers.
+// Each frame makes three calls (upsample, getOSBuffer, downsample), as Cosmos and SlewLFO do.
+// The halfband banks the modules use dispatch on their number of stages with a switch as well, their time for the
+// same three calls (one signal in each bank) is listed last.
+
+static const int numFrames = 1 << 16;
+
+template <typename T>
+static T processFrame(T* osBuffer, int ratio) {
+	for (int k = 0; k < ratio; k++) {
+		osBuffer[k] = 0.5f * osBuffer[k];
+	}
+	return osBuffer[0];
+}
+
+template <typename T>
+static void run() {
+	chowdsp::HalfbandOversampling<1, 6, T> os0;
+	chowdsp::HalfbandOversampling<2, 6, T> os1;
+	chowdsp::HalfbandOversampling<4, 6, T> os2;
+	chowdsp::HalfbandOversampling<8, 6, T> os3;
+	chowdsp::HalfbandOversampling<16, 6, T> os4;
+	chowdsp::BaseOversampling<T>* oss[5] = { &os0, &os1, &os2, &os3, &os4 };
+	chowdsp::VariableOversampling<6, T, chowdsp::HalfbandOversampling> variable;
+	const std::vector<T> input = bench::makeTestSignal<T>(numFrames);
+
+	for (int idx = 0; idx < 5; idx++) {
+		// read through a volatile, so the compiler can't resolve the virtual call from a known index
+		volatile int runtimeIdx = idx;
+		const int ratio = 1 << idx;
+
+		oss[idx]->reset(48000.f);
+		const double virtualNs = bench::nsPerFrame([&]() {
+			for (int n = 0; n < numFrames; n++) {
+				chowdsp::BaseOversampling<T>* os = oss[runtimeIdx];
+				os->upsample(input[n]);
+				processFrame(os->getOSBuffer(), ratio);
+				bench::doNotOptimise(os->downsample());
+			}
+		}, numFrames);
+
+		variable.setOversamplingIndex(runtimeIdx);
+		variable.reset(48000.f);
+		const double switchNs = bench::nsPerFrame([&]() {
+			for (int n = 0; n < numFrames; n++) {
+				variable.upsample(input[n]);
+				processFrame(variable.getOSBuffer(), ratio);
+				bench::doNotOptimise(variable.downsample());
+			}
+		}, numFrames);
+
+		chowdsp::HalfbandUpsamplingBank<1, 6, T> upsampler;
+		chowdsp::HalfbandDownsamplingBank<1, 6, T> downsampler;
+		upsampler.setOversamplingIndex(runtimeIdx);
+		downsampler.setOversamplingIndex(runtimeIdx);
+		const double bankNs = bench::nsPerFrame([&]() {
+			for (int n = 0; n < numFrames; n++) {
+				upsampler.upsample(&input[n]);
+				T* osBuffer = downsampler.getOSBuffer(0);
+				std::copy(upsampler.getOSBuffer(0), upsampler.getOSBuffer(0) + ratio, osBuffer);
+				processFrame(osBuffer, ratio);
+				T y;
+				downsampler.downsample(&y);
+				bench::doNotOptimise(y);
+			}
+		}, numFrames);
+
+		std::printf("%-8s x%-3d %10.2f %10.2f %10.2f %10.2f\n", bench::typeName<T>(), ratio, virtualNs, switchNs, (virtualNs - switchNs) / 3.0, bankNs);
+	}
+}
+
+int main() {
+	std::printf("%-8s %-4s %10s %10s %10s %10s\n", "type", "ratio", "virtual", "switch", "saving", "banks");
+	std::printf("%-8s %-4s %10s %10s %10s %10s\n", "", "", "ns/frame", "ns/frame", "ns/call", "ns/frame");
+	run<simd::float_4>();
+	run<double>();
+	return 0;
+}
@@ -0,0 +1,46 @@
+#include "bench.hpp"
+
+// Cost of the anti-aliasing filter realisations: AAFilter (cascade of biquads) against the polyphase halfband
+// cascade. Each frame upsamples, leaves the oversampled buffer as is, and downsamples. The Butterworth cascade has a
+// single quality, so it is timed once per ratio.
+
+static const int numFrames = 1 << 16;
+
+template <typename OS, typename T>
+static double timeOversampler(const std::vector<T>& input, chowdsp::FilterQuality quality) {
+	OS os;
+	os.setQuality(quality);
+	os.reset(48000.f);
+	return bench::nsPerFrame([&]() {
+		for (int n = 0; n < numFrames; n++) {
+			os.upsample(input[n]);
+			bench::doNotOptimise(os.downsample());
+		}
+	}, numFrames);
+}
+
+template <typename T, int ratio>
+static void run() {
+	const std::vector<T> input = bench::makeTestSignal<T>(numFrames);
+	const char* qualityNames[] = {"eco", "standard", "high", "low-latency"};
+	const double cascadeNs = timeOversampler<chowdsp::Oversampling<ratio, 6, T>>(input, chowdsp::STANDARD);
+
+	for (int q = 0; q < chowdsp::NUM_QUALITIES; q++) {
+		const chowdsp::FilterQuality quality = (chowdsp::FilterQuality) q;
+		const double halfbandNs = timeOversampler<chowdsp::HalfbandOversampling<ratio, 6, T>>(input, quality);
+
+		std::printf("%-8s x%-3d %-9s %10.2f %10.2f\n", bench::typeName<T>(), ratio, qualityNames[q], cascadeNs, halfbandNs);
+	}
+}
+
+int main() {
+	std::printf("%-8s %-4s %-9s %10s %10s\n", "type", "ratio", "quality", "cascade", "halfband");
+	std::printf("%-8s %-4s %-9s %10s %10s\n", "", "", "", "ns/frame", "ns/frame");
+	run<double, 4>();
+	run<double, 16>();
+	run<float, 4>();
+	run<float, 16>();
+	run<simd::float_4, 4>();
+	run<simd::float_4, 16>();
+	return 0;
+}
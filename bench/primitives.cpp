@@ -0,0 +1,165 @@
+#include "bench.hpp"
+
+// Cost of each ChowDSP primitive on its own: IIRFilter per order, AAFilter per number of sections, the
+// upsample and downsample paths of Oversampling and HalfbandOversampling per ratio, and HalfbandDownsamplingBank
+// (per frame and per block) per ratio, for float, double and float_4.
+// The input is a moving test signal, so the oversamplers' settled bypass never kicks in.
+//
+// Prints one line per case (primitive, size, type, path, ns per sample), in the same order every run, so the
+// output of two commits can be compared line by line, e.g.:
+//     git checkout A && make bench && build/bench/primitives > a.txt
+//     git checkout B && make bench && build/bench/primitives > b.txt
+//     paste a.txt b.txt
+// For oversamplers, a sample is one base rate frame (i.e. `ratio` oversampled samples), of one signal for the bank.
+
+static const int numFrames = 1 << 14;
+
+static void report(const char* primitive, int size, const char* type, const char* path, double ns) {
+	std::printf("%-20s %3d  %-8s %-10s %8.2f\n", primitive, size, type, path, ns);
+}
+
+template <typename T, int ORDER>
+static void timeIIRFilter(const std::vector<T>& input) {
+	// all poles at z = 0.5, so the filter is stable whatever the order
+	T b[ORDER], a[ORDER];
+	for (int i = 0; i < ORDER; i++) {
+		double binomial = 1.0;
+		for (int j = 0; j < i; j++)
+			binomial = binomial * (ORDER - 1 - j) / (j + 1);
+		a[i] = T(binomial * std::pow(-0.5, i));
+		b[i] = T(1.f / ORDER);
+	}
+
+	chowdsp::IIRFilter<ORDER, T> filter;
+	filter.setCoefficients(b, a);
+	const double ns = bench::nsPerFrame([&]() {
+		for (int n = 0; n < numFrames; n++)
+			bench::doNotOptimise(filter.process(input[n]));
+	}, numFrames);
+	report("IIRFilter", ORDER - 1, bench::typeName<T>(), "process", ns);
+}
+
+template <typename T, int N>
+static void timeAAFilter(const std::vector<T>& input) {
+	chowdsp::AAFilter<N, T> filter;
+	filter.reset(48000.f, 4);
+	const double ns = bench::nsPerFrame([&]() {
+		for (int n = 0; n < numFrames; n++)
+			bench::doNotOptimise(filter.process(input[n]));
+	}, numFrames);
+	report("AAFilter", N, bench::typeName<T>(), "process", ns);
+}
+
+/** Times upsample() and downsample() of an oversampler (with a `getOSBuffer()` of `ratio` samples) separately */
+template <typename OS, typename T>
+static void timeOversampler(OS& os, const char* primitive, int ratio, const std::vector<T>& input, const std::vector<T>& osInput) {
+	const double upNs = bench::nsPerFrame([&]() {
+		for (int n = 0; n < numFrames; n++) {
+			os.upsample(input[n]);
+			bench::doNotOptimise(os.getOSBuffer()[0]);
+		}
+	}, numFrames);
+
+	// the oversampled buffer is refilled with a moving signal each frame, which is included in the time
+	const double downNs = bench::nsPerFrame([&]() {
+		for (int n = 0; n < numFrames; n++) {
+			T* osBuffer = os.getOSBuffer();
+			for (int k = 0; k < ratio; k++)
+				osBuffer[k] = osInput[n * ratio + k];
+			bench::doNotOptimise(os.downsample());
+		}
+	}, numFrames);
+
+	report(primitive, ratio, bench::typeName<T>(), "upsample", upNs);
+	report(primitive, ratio, bench::typeName<T>(), "downsample", downNs);
+}
+
+template <typename T, int ratio>
+static void timeOversampling(const std::vector<T>& input, const std::vector<T>& osInput) {
+	chowdsp::Oversampling<ratio, 4, T> os;
+	os.reset(48000.f);
+	timeOversampler(os, "Oversampling", ratio, input, osInput);
+}
+
+template <typename T, int ratio>
+static void timeHalfbandOversampling(const std::vector<T>& input, const std::vector<T>& osInput) {
+	chowdsp::HalfbandOversampling<ratio, 6, T> os;
+	os.reset(48000.f);
+	timeOversampler(os, "HalfbandOversampling", ratio, input, osInput);
+}
+
+/** Downsampling of 3 signals (as COSMOS' logic outputs) together, per signal so it compares with HalfbandOversampling */
+template <typename T>
+static void timeDownsamplingBank(int idx, const std::vector<T>& osInput) {
+	const int K = 3;
+	chowdsp::HalfbandDownsamplingBank<K, 6, T> bank;
+	bank.setOversamplingIndex(idx);
+	const int ratio = bank.getOversamplingRatio();
+
+	const double ns = bench::nsPerFrame([&]() {
+		for (int n = 0; n < numFrames; n++) {
+			for (int k = 0; k < K; k++) {
+				T* osBuffer = bank.getOSBuffer(k);
+				for (int i = 0; i < ratio; i++)
+					osBuffer[i] = osInput[n * ratio + i] + T(k);
+			}
+			T y[K];
+			bank.downsample(y);
+			bench::doNotOptimise(y);
+		}
+	}, numFrames * K);
+	report("DownsamplingBank", ratio, bench::typeName<T>(), "downsample", ns);
+
+	// the same through the block API, in blocks of 32 frames
+	const int blockSize = 32;
+	bank.setMaxBlockSize(blockSize);
+	std::vector<T> y(K * blockSize);
+	const double blockNs = bench::nsPerFrame([&]() {
+		for (int n = 0; n < numFrames; n += blockSize) {
+			for (int k = 0; k < K; k++) {
+				T* osBlock = bank.getOSBlockBuffer(k);
+				for (int i = 0; i < ratio * blockSize; i++)
+					osBlock[i] = osInput[n * ratio + i] + T(k);
+			}
+			bank.downsampleBlock(y.data(), blockSize);
+			bench::doNotOptimise(y[0]);
+		}
+	}, numFrames * K);
+	report("DownsamplingBank", ratio, bench::typeName<T>(), "block", blockNs);
+}
+
+template <typename T>
+static void run() {
+	const std::vector<T> input = bench::makeTestSignal<T>(numFrames);
+	const std::vector<T> osInput = bench::makeTestSignal<T>(16 * numFrames);
+
+	timeIIRFilter<T, 2>(input);
+	timeIIRFilter<T, 3>(input);
+	timeIIRFilter<T, 5>(input);
+	timeIIRFilter<T, 9>(input);
+
+	timeAAFilter<T, 2>(input);
+	timeAAFilter<T, 4>(input);
+	timeAAFilter<T, 6>(input);
+
+	timeOversampling<T, 2>(input, osInput);
+	timeOversampling<T, 4>(input, osInput);
+	timeOversampling<T, 8>(input, osInput);
+	timeOversampling<T, 16>(input, osInput);
+
+	timeHalfbandOversampling<T, 2>(input, osInput);
+	timeHalfbandOversampling<T, 4>(input, osInput);
+	timeHalfbandOversampling<T, 8>(input, osInput);
+	timeHalfbandOversampling<T, 16>(input, osInput);
+
+	for (int idx = 1; idx < 5; idx++)
+		timeDownsamplingBank<T>(idx, osInput);
+}
+
+int main() {
+	std::printf("%-20s %3s  %-8s %-10s %8s\n", "primitive", "size", "type", "path", "ns/sample");
+	run<float>();
+	run<double>();
+	run<simd::float_4>();
+	return 0;
+}
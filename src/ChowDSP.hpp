@@ -1,5 +1,9 @@
 #pragma once
 #include <rack.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
 
 
 namespace chowdsp {
@@ -9,6 +13,214 @@ namespace chowdsp {
 	// * oversampling.hpp
 	// * iir.hpp
 
+/** Anti-aliasing filter quality, trading stopband rejection against CPU and latency */
+enum FilterQuality {
+	ECO,
+	STANDARD,
+	HIGH,
+	LOW_LATENCY, // the least group delay, with ~40dB of rejection
+	NUM_QUALITIES
+};
+
+
+/**
+    Denormal protection. Filter states decaying towards zero (e.g. once the input goes silent) eventually become
+    denormal, which is very slow on most CPUs. Two complementary mechanisms are provided:
+     * `ScopedNoDenormals` sets flush-to-zero/denormals-are-zero for the current thread while in scope (Rack's
+       engine threads already run like this on x86, but benchmarks and other hosts may not)
+     * `snapToZero()` sets values below `DenormalThreshold` to exactly zero, the filters below provide a
+       `snapToZero()` method for their state, which the oversamplers call every `DenormalSnapInterval` samples
+*/
+static constexpr float DenormalThreshold = 1e-15f;
+
+/** Oversamplers flush their filter states every this many (base rate) samples, filter states take thousands of
+ samples to decay from `DenormalThreshold` to denormals so this is plenty, and costs well under a value per sample */
+static constexpr int DenormalSnapInterval = 64;
+
+struct ScopedNoDenormals {
+	ScopedNoDenormals() {
+#if defined(__SSE__)
+		previous = _mm_getcsr();
+		_mm_setcsr(previous | 0x8040); // FTZ | DAZ
+#elif defined(__aarch64__)
+		asm volatile("mrs %0, fpcr" : "=r"(previous));
+		asm volatile("msr fpcr, %0" : : "r"(previous | (1 << 24))); // FZ
+#endif
+	}
+
+	~ScopedNoDenormals() {
+#if defined(__SSE__)
+		_mm_setcsr(previous);
+#elif defined(__aarch64__)
+		asm volatile("msr fpcr, %0" : : "r"(previous));
+#endif
+	}
+
+private:
+#if defined(__SSE__)
+	unsigned int previous = 0;
+#elif defined(__aarch64__)
+	uint64_t previous = 0;
+#endif
+};
+
+/** Sets (each lane of) `x` to zero if its magnitude is below `DenormalThreshold` */
+template <typename T>
+inline void snapToZero(T& x) noexcept {
+	x = ifelse(abs(x) < T(DenormalThreshold), T(0.f), x);
+}
+
+inline void snapToZero(float& x) noexcept {
+	if (std::abs(x) < DenormalThreshold)
+		x = 0.f;
+}
+
+inline void snapToZero(double& x) noexcept {
+	if (std::abs(x) < DenormalThreshold)
+		x = 0.0;
+}
+
+/** Calls `snapToZero()` on `numSamples` values */
+template <typename T>
+inline void snapToZero(T* x, int numSamples) noexcept {
+	for (int i = 0; i < numSamples; i++)
+		snapToZero(x[i]);
+}
+
+/** Counts processed samples, returns true from `due()` every `DenormalSnapInterval` samples */
+struct DenormalSnapCounter {
+	int samplesSinceSnap = 0;
+
+	inline bool due(int numSamples) noexcept {
+		samplesSinceSnap += numSamples;
+		if (samplesSinceSnap < DenormalSnapInterval)
+			return false;
+
+		samplesSinceSnap = 0;
+		return true;
+	}
+};
+
+/** Copies the first `numLanes` lanes of `n` vectors to vectors of another SIMD width (e.g. float_4 to float_8) */
+template <typename T, typename U>
+inline void copyLanes(const U* from, T* to, int n, int numLanes) noexcept {
+	for (int i = 0; i < n; i++) {
+		for (int l = 0; l < numLanes; l++)
+			to[i][l] = from[i][l];
+	}
+}
+
+/** Whether all lanes of a comparison mask are set */
+template <typename T>
+inline bool allLanes(const T& mask) noexcept {
+	return movemask(mask) == (1 << T::size) - 1;
+}
+
+inline bool allLanes(bool mask) noexcept {
+	return mask;
+}
+
+/** Whether (all lanes of) `x` are within +/-`tolerance` */
+template <typename T>
+inline bool allWithin(const T& x, float tolerance) noexcept {
+	return allLanes(abs(x) <= T(tolerance));
+}
+
+inline bool allWithin(float x, float tolerance) noexcept {
+	return std::abs(x) <= tolerance;
+}
+
+inline bool allWithin(double x, float tolerance) noexcept {
+	return std::abs(x) <= tolerance;
+}
+
+/**
+    Settled-state bypass for oversampling filters. When the input has been constant (every sample equal) since the
+    last check, and the output hasn't changed (to within `SettleTolerance`) since then either, the filter has reached
+    its steady state, so the last output frame can be repeated for as long as the input stays the same, without
+    running the filter. The filter state is left as it was, which is the steady state, so processing resumes cleanly
+    when the input changes. Checks are made every `DenormalSnapInterval` samples, so that the per sample cost while
+    not settled is just a comparison. Output frames are `NumOut` samples (e.g. `ratio` for upsampling).
+*/
+template <typename T, int NumOut>
+struct SettledBypass {
+	/** Largest change in output between checks still considered settled (well below -100dB for +/-10V signals) */
+	static constexpr float SettleTolerance = 1e-5f;
+
+	/** Forgets the held frame, e.g. when the filter state or coefficients change */
+	void reset() noexcept {
+		settled = false;
+		changed = Mask(T(0.f) == T(0.f));
+	}
+
+	/**
+	 * If settled and all `numIn` input samples match the held input, writes `numFrames` held output frames to `out`
+	 * and returns true. Otherwise returns false, and the input must be processed (and passed to `track()`).
+	 */
+	inline bool bypass(const T* in, int numIn, T* out, int numFrames) noexcept {
+		if (!settled)
+			return false;
+
+		Mask same = (in[0] == input);
+		for (int i = 1; i < numIn; i++)
+			same = same & (in[i] == input);
+		if (!allLanes(same)) {
+			reset();
+			return false;
+		}
+		for (int n = 0; n < numFrames; n++)
+			std::copy(output, output + NumOut, &out[n * NumOut]);
+		return true;
+	}
+
+	/** Notes whether any of `numIn` processed input samples differ from the previous one */
+	inline void track(const T* in, int numIn) noexcept {
+		Mask c = (in[0] != input);
+		for (int i = 1; i < numIn; i++)
+			c = c | (in[i] != in[i - 1]);
+		changed = changed | c;
+		input = in[numIn - 1];
+	}
+
+	/**
+	 * Checks whether the filter has settled, given its latest output frame. Call every `DenormalSnapInterval` samples.
+	 * Not inlined, as it runs rarely and would otherwise bloat the per sample code it's called from.
+	 */
+	__attribute__((noinline)) void check(const T* frameOut) noexcept {
+		settled = !anyLane(changed) && matchesOutput(frameOut);
+		if (!settled)
+			std::copy(frameOut, frameOut + NumOut, output);
+		changed = Mask(T(0.f) != T(0.f));
+	}
+
+private:
+	// comparison result, bool for scalars or a SIMD mask
+	typedef decltype(T() != T()) Mask;
+
+	static bool anyLane(bool mask) noexcept {
+		return mask;
+	}
+
+	template <typename M>
+	static bool anyLane(const M& mask) noexcept {
+		return movemask(mask) != 0;
+	}
+
+	inline bool matchesOutput(const T* frameOut) const noexcept {
+		for (int k = 0; k < NumOut; k++) {
+			if (!allWithin(frameOut[k] - output[k], SettleTolerance))
+				return false;
+		}
+		return true;
+	}
+
+	bool settled = false;
+	Mask changed = Mask(T(0.f) == T(0.f)); // whether the input changed since the last check
+	T input = 0.f; // the last input sample
+	T output[NumOut] = {}; // the output frame at the last check
+};
+
+
 template <int ORDER, typename T = float>
 struct IIRFilter {
 	/** transfer function numerator coefficients: b_0, b_1, etc.*/
@@ -28,6 +240,11 @@ struct IIRFilter {
 		std::fill(z, &z[ORDER], 0.0f);
 	}
 
+	/** Flushes tiny state values to zero, to avoid denormals */
+	void snapToZero() noexcept {
+		chowdsp::snapToZero(z, ORDER);
+	}
+
 	void setCoefficients(const T* b, const T* a) {
 		for (int i = 0; i < ORDER; i++) {
 			this->b[i] = b[i];
@@ -68,14 +285,14 @@ struct IIRFilter {
 	s: normalized angular frequency equal to $2 \pi f / f_{sr}$ ($\pi$ is the Nyquist frequency)
 	*/
 	std::complex<T> getTransferFunction(T s) {
-		// Compute sum(a_k z^-k) / sum(b_k z^-k) where z = e^(i s)
+		// Compute sum(b_k z^-k) / sum(a_k z^-k) where z = e^(i s), and a_0 = 1
 		std::complex<T> bSum(b[0], 0);
 		std::complex<T> aSum(1, 0);
 		for (int i = 1; i < ORDER; i++) {
 			T p = -i * s;
 			std::complex<T> z(simd::cos(p), simd::sin(p));
 			bSum += b[i] * z;
-			aSum += a[i - 1] * z;
+			aSum += a[i] * z;
 		}
 		return bSum / aSum;
 	}
@@ -222,12 +439,23 @@ typedef TBiquadFilter<> BiquadFilter;
     High-order filter to be used for anti-aliasing or anti-imaging.
     The template parameter N should be 1/2 the desired filter order.
 
-    Currently uses an 2*N-th order Butterworth filter.
+    Currently uses an 2*N-th order Butterworth filter, as a cascade of N biquad sections,
+    with its -3dB point at 0.85 * Nyquist. (The selectable filter qualities are those of the halfband
+    oversamplers, which the modules use.)
+
+    Coefficients are computed once per (sample rate, oversampling ratio) and shared by all
+    filters of the same order and type, each filter only holds its own state.
     source: https://github.com/jatinchowdhury18/ChowDSP-VCV/blob/master/src/shared/AAFilter.hpp
 */
 template<int N, typename T>
 class AAFilter {
 public:
+	/** Transfer function coefficients for each biquad section (a_0 = 1 is implied) */
+	struct Coefficients {
+		T b[N][3] = {};
+		T a[N][3] = {};
+	};
+
 	AAFilter() = default;
 
 	/** Calculate Q values for a Butterworth filter of a given order */
@@ -244,6 +472,51 @@ public:
 		return Qs;
 	}
 
+	/**
+	 * Returns the shared coefficients for a given base sample rate and oversampling ratio. These are
+	 * computed on first use, so this isn't realtime safe (but can be called from any thread).
+	 */
+	static const Coefficients& getCoefficients(float sampleRate, int osRatio) {
+		static std::mutex cacheMutex;
+		static std::map<std::pair<float, int>, std::unique_ptr<Coefficients>> cache;
+
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		std::unique_ptr<Coefficients>& coeffs = cache[ {sampleRate, osRatio}];
+		if (!coeffs) {
+			static const std::vector<float> Qs = calculateButterQs(2 * N);
+			const float fc = 0.85f * (sampleRate / 2.0f);
+
+			coeffs.reset(new Coefficients);
+			for (int i = 0; i < N; ++i) {
+				TBiquadFilter<T> biquad;
+				biquad.setParameters(TBiquadFilter<T>::Type::LOWPASS, fc / (osRatio * sampleRate), Qs[i], 1.0f);
+				std::copy(biquad.b, biquad.b + 3, coeffs->b[i]);
+				std::copy(biquad.a, biquad.a + 3, coeffs->a[i]);
+			}
+		}
+		return *coeffs;
+	}
+
+	/** Group delay at DC of the filter for a given base sample rate and oversampling ratio, in oversampled samples */
+	static double getGroupDelay(float sampleRate, int osRatio) {
+		const Coefficients& coeffs = getCoefficients(sampleRate, osRatio);
+		double delay = 0.0;
+		for (int i = 0; i < N; ++i) {
+			// for H(z) = sum(b_k z^-k) / sum(a_k z^-k), the delay at z = 1 is sum(k b_k) / sum(b_k) - sum(k a_k) / sum(a_k)
+			double bSum = 0.0, bMoment = 0.0, aSum = 1.0, aMoment = 0.0;
+			for (int k = 0; k < 3; ++k) {
+				bSum += coeffs.b[i][k];
+				bMoment += k * coeffs.b[i][k];
+			}
+			for (int k = 1; k < 3; ++k) {
+				aSum += coeffs.a[i][k];
+				aMoment += k * coeffs.a[i][k];
+			}
+			delay += bMoment / bSum - aMoment / aSum;
+		}
+		return delay;
+	}
+
 	/**
 	 * Resets the filter to process at a new sample rate.
 	 *
@@ -251,24 +524,40 @@ public:
 	 * @param osRatio: The oversampling ratio at which the filter is being used
 	 */
 	void reset(float sampleRate, int osRatio) {
-		float fc = 0.85f * (sampleRate / 2.0f);
-		auto Qs = calculateButterQs(2 * N);
+		coeffs = &getCoefficients(sampleRate, osRatio);
+	}
 
-		for (int i = 0; i < N; ++i)
-			filters[i].setParameters(TBiquadFilter<T>::Type::LOWPASS, fc / (osRatio * sampleRate), Qs[i], 1.0f);
+	/** Flushes tiny state values to zero, to avoid denormals */
+	void snapToZero() noexcept {
+		chowdsp::snapToZero(&z[0][0], 2 * N);
 	}
 
 	inline T process(T x) noexcept {
-		for (int i = 0; i < N; ++i)
-			x = filters[i].process(x);
+		// biquads in transposed direct form II, as IIRFilter<3, T>
+		for (int i = 0; i < N; ++i) {
+			const T y = z[i][0] + x * coeffs->b[i][0];
+			z[i][0] = z[i][1] + x * coeffs->b[i][1] - y * coeffs->a[i][1];
+			z[i][1] = x * coeffs->b[i][2] - y * coeffs->a[i][2];
+			x = y;
+		}
 
 		return x;
 	}
 
 private:
-	TBiquadFilter<T> filters[N];
-};
+	static const Coefficients& getPassthrough() {
+		static const Coefficients passthrough = []() {
+			Coefficients c;
+			for (int i = 0; i < N; ++i)
+				c.b[i][0] = 1.0f;
+			return c;
+		}();
+		return passthrough;
+	}
 
+	const Coefficients* coeffs = &getPassthrough(); // until reset() is called
+	T z[N][2] = {}; // filter state
+};
 
 
 /**
@@ -284,6 +573,9 @@ public:
 	/** Resets the oversampler for processing at some base sample rate */
 	virtual void reset(float /*baseSampleRate*/) = 0;
 
+	/** Selects the anti-aliasing/anti-imaging filter design, takes effect immediately (filter state is kept) */
+	virtual void setQuality(FilterQuality /*quality*/) = 0;
+
 	/** Upsample a single input sample and update the oversampled buffer */
 	virtual void upsample(T) noexcept = 0;
 
@@ -292,6 +584,24 @@ public:
 
 	/** Returns a pointer to the oversampled buffer */
 	virtual T* getOSBuffer() noexcept = 0;
+
+	/** Group delay at DC added by `upsample()`, in base rate samples */
+	virtual double getUpsamplingLatency() const = 0;
+
+	/** Group delay at DC added by `downsample()`, in base rate samples (counting from the start of the oversampled buffer) */
+	virtual double getDownsamplingLatency() const = 0;
+
+	/** Group delay at DC of an oversampled process (upsampling then downsampling), in base rate samples */
+	double getLatency() const {
+		return getUpsamplingLatency() + getDownsamplingLatency();
+	}
+
+	/** Upsample `numSamples` input samples into `ratio * numSamples` samples of `osBlock` (which must not alias `x`) */
+	virtual void upsampleBlock(const T* x, T* osBlock, int numSamples) noexcept = 0;
+
+	/** Downsample `ratio * numSamples` samples of `osBlock` into `numSamples` output samples.
+	 `osBlock` is left intact, `scratch` must hold at least `ratio * numSamples / 2` samples. */
+	virtual void downsampleBlock(const T* osBlock, T* y, T* scratch, int numSamples) noexcept = 0;
 };
 
 
@@ -306,32 +616,58 @@ public:
         oversample.osBuffer[k] = processSample(oversample.osBuffer[k]);
     float y = oversample.downsample();
     @endcode
+
+    While the input is constant and the filters have settled (e.g. a gate held high), the filters are
+    bypassed and the settled output repeated, see `SettledBypass`.
 */
 template<int ratio, int filtN = 4, typename T = float>
-class Oversampling : public BaseOversampling<T> {
+class Oversampling final : public BaseOversampling<T> {
 public:
 	Oversampling() = default;
 	virtual ~Oversampling() {}
 
 	void reset(float baseSampleRate) override {
-		aaFilter.reset(baseSampleRate, ratio);
-		aiFilter.reset(baseSampleRate, ratio);
+		sampleRate = baseSampleRate;
+		aaFilter.reset(sampleRate, ratio);
+		aiFilter.reset(sampleRate, ratio);
 		std::fill(osBuffer, &osBuffer[ratio], 0.0f);
+		upBypass.reset();
+		downBypass.reset();
 	}
 
+	// the Butterworth design comes in one quality
+	void setQuality(FilterQuality /*newQuality*/) override {}
+
 	inline void upsample(T x) noexcept override {
+		if (upBypass.bypass(&x, 1, osBuffer, 1))
+			return;
+
 		osBuffer[0] = ratio * x;
 		std::fill(&osBuffer[1], &osBuffer[ratio], 0.0f);
 
 		for (int k = 0; k < ratio; k++)
 			osBuffer[k] = aiFilter.process(osBuffer[k]);
+
+		upBypass.track(&x, 1);
+		if (upSnapCounter.due(1)) {
+			aiFilter.snapToZero();
+			upBypass.check(osBuffer);
+		}
 	}
 
 	inline T downsample() noexcept override {
 		T y = 0.0f;
+		if (downBypass.bypass(osBuffer, ratio, &y, 1))
+			return y;
+
 		for (int k = 0; k < ratio; k++)
 			y = aaFilter.process(osBuffer[k]);
 
+		downBypass.track(osBuffer, ratio);
+		if (downSnapCounter.due(1)) {
+			aaFilter.snapToZero();
+			downBypass.check(&y);
+		}
 		return y;
 	}
 
@@ -339,16 +675,982 @@ public:
 		return osBuffer;
 	}
 
+	double getUpsamplingLatency() const override {
+		// the input sample is placed at the start of each oversampled frame
+		return AAFilter<filtN, double>::getGroupDelay(sampleRate, ratio) / ratio;
+	}
+
+	double getDownsamplingLatency() const override {
+		// the output is the filter's last sample of each frame, ratio - 1 samples after its start
+		return (AAFilter<filtN, double>::getGroupDelay(sampleRate, ratio) - (ratio - 1)) / ratio;
+	}
+
+	inline void upsampleBlock(const T* x, T* osBlock, int numSamples) noexcept override {
+		if (upBypass.bypass(x, numSamples, osBlock, numSamples))
+			return;
+
+		for (int n = 0; n < numSamples; n++) {
+			T* frame = &osBlock[n * ratio];
+			frame[0] = aiFilter.process(ratio * x[n]);
+			for (int k = 1; k < ratio; k++)
+				frame[k] = aiFilter.process(0.0f);
+		}
+		upBypass.track(x, numSamples);
+		if (upSnapCounter.due(numSamples)) {
+			aiFilter.snapToZero();
+			upBypass.check(&osBlock[(numSamples - 1) * ratio]);
+		}
+	}
+
+	inline void downsampleBlock(const T* osBlock, T* y, T* /*scratch*/, int numSamples) noexcept override {
+		if (downBypass.bypass(osBlock, ratio * numSamples, y, numSamples))
+			return;
+
+		for (int n = 0; n < numSamples; n++) {
+			const T* frame = &osBlock[n * ratio];
+			for (int k = 0; k < ratio; k++)
+				y[n] = aaFilter.process(frame[k]);
+		}
+		downBypass.track(osBlock, ratio * numSamples);
+		if (downSnapCounter.due(numSamples)) {
+			aaFilter.snapToZero();
+			downBypass.check(&y[numSamples - 1]);
+		}
+	}
+
 	T osBuffer[ratio];
 
 private:
+	float sampleRate = 44100.f;
 	AAFilter<filtN, T> aaFilter; // anti-aliasing filter
 	AAFilter<filtN, T> aiFilter; // anti-imaging filter
+	DenormalSnapCounter upSnapCounter, downSnapCounter;
+	SettledBypass<T, ratio> upBypass;
+	SettledBypass<T, 1> downBypass;
 };
 
 typedef Oversampling<1, 4, simd::float_4> OversamplingSIMD;
 
 
+/**
+    Coefficient design for polyphase IIR halfband filters, i.e. two parallel chains of
+    first order allpass sections (in z^-2) whose average is a halfband lowpass.
+    The design is elliptic, following Laurent de Soras' HIIR library (http://ldesoras.free.fr/prod.html).
+
+    All lengths are normalised to the (higher) sample rate of the 2x stage, so the transition
+    band is centred on 0.25 and `transition` is its half-width.
+*/
+struct HalfbandDesigner {
+
+	/** Computes `numCoefs` allpass coefficients for a given transition half-width */
+	static void computeCoefs(double* coefs, int numCoefs, double transition) {
+		double k, q;
+		computeTransitionParams(k, q, transition);
+		const int order = numCoefs * 2 + 1;
+		for (int i = 0; i < numCoefs; ++i) {
+			coefs[i] = computeCoef(i, k, q, order);
+		}
+	}
+
+	/** Estimated stopband attenuation (dB) of a design with `numCoefs` coefficients */
+	static double computeAttenuation(int numCoefs, double transition) {
+		double k, q;
+		computeTransitionParams(k, q, transition);
+		const int order = numCoefs * 2 + 1;
+		const double a = 4.0 * std::pow(q, order * 0.5);
+		return -10.0 * std::log10(a / (1.0 + a));
+	}
+
+	/** Smallest number of coefficients that reaches `attenuation` dB of stopband rejection */
+	static int computeNumCoefs(double attenuation, double transition, int maxNumCoefs) {
+		int numCoefs = 1;
+		while (numCoefs < maxNumCoefs && computeAttenuation(numCoefs, transition) < attenuation) {
+			numCoefs++;
+		}
+		return numCoefs;
+	}
+
+private:
+	static void computeTransitionParams(double& k, double& q, double transition) {
+		k = std::tan((1.0 - transition * 2.0) * M_PI / 4.0);
+		k *= k;
+		const double kksqrt = std::pow(1.0 - k * k, 0.25);
+		const double e = 0.5 * (1.0 - kksqrt) / (1.0 + kksqrt);
+		const double e4 = e * e * e * e;
+		q = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+	}
+
+	static double computeCoef(int index, double k, double q, int order) {
+		const int c = index + 1;
+
+		// numerator and denominator are rapidly converging series
+		double num = 0.0, term = 0.0;
+		int i = 0, sign = 1;
+		do {
+			term = std::pow(q, i * (i + 1)) * std::sin((i * 2 + 1) * c * M_PI / order) * sign;
+			num += term;
+			sign = -sign;
+			++i;
+		}
+		while (std::abs(term) > 1e-100);
+		num *= std::pow(q, 0.25);
+
+		double den = 0.0;
+		i = 1;
+		sign = -1;
+		do {
+			term = std::pow(q, i * i) * std::cos(i * 2 * c * M_PI / order) * sign;
+			den += term;
+			sign = -sign;
+			++i;
+		}
+		while (std::abs(term) > 1e-100);
+		den += 0.5;
+
+		const double ww = num / den;
+		const double wwsq = ww * ww;
+		const double x = std::sqrt((1.0 - wwsq * k) * (1.0 - wwsq / k)) / (1.0 + wwsq);
+		return (1.0 - x) / (1.0 + x);
+	}
+};
+
+/**
+    A single 2x polyphase halfband stage, holding filter state for one direction (up or down).
+    Even coefficients belong to the first allpass path, odd ones to the second. Only the
+    samples that are actually needed are computed: upsampling never filters stuffed zeros,
+    and downsampling never computes the discarded samples.
+*/
+template<int MaxCoefs, typename T>
+struct HalfbandStage {
+	T x1[MaxCoefs] = {};
+	T y1[MaxCoefs] = {};
+
+	void reset() {
+		std::fill(x1, &x1[MaxCoefs], 0.0f);
+		std::fill(y1, &y1[MaxCoefs], 0.0f);
+	}
+
+	/** Flushes tiny state values to zero, to avoid denormals */
+	void snapToZero() noexcept {
+		chowdsp::snapToZero(x1, MaxCoefs);
+		chowdsp::snapToZero(y1, MaxCoefs);
+	}
+
+	/** Produces two output samples (at twice the rate) from one input sample */
+	inline void upsample(T x, T& out0, T& out1, const T* coefs, int numCoefs) noexcept {
+		T path0 = x;
+		for (int i = 0; i < numCoefs; i += 2)
+			path0 = allpass(i, path0, coefs[i]);
+
+		T path1 = x;
+		for (int i = 1; i < numCoefs; i += 2)
+			path1 = allpass(i, path1, coefs[i]);
+
+		out0 = path0;
+		out1 = path1;
+	}
+
+	/** Produces one output sample (at half the rate) from two consecutive input samples */
+	inline T downsample(T in0, T in1, const T* coefs, int numCoefs) noexcept {
+		T path0 = in1;
+		for (int i = 0; i < numCoefs; i += 2)
+			path0 = allpass(i, path0, coefs[i]);
+
+		T path1 = in0;
+		for (int i = 1; i < numCoefs; i += 2)
+			path1 = allpass(i, path1, coefs[i]);
+
+		return 0.5f * (path0 + path1);
+	}
+
+private:
+	// first order allpass in z^-2, run at the lower rate: y[n] = c * (x[n] - y[n-1]) + x[n-1]
+	inline T allpass(int i, T x, T c) noexcept {
+		const T y = c * (x - y1[i]) + x1[i];
+		x1[i] = x;
+		y1[i] = y;
+		return y;
+	}
+};
+
+template <int K, int filtN, typename T>
+class HalfbandDownsamplingBank;
+template <int K, int filtN, typename T>
+class HalfbandUpsamplingBank;
+
+/**
+    Oversampler built from a cascade of 2x polyphase IIR halfband stages, with the same interface as `Oversampling`.
+    This is much cheaper than `Oversampling` as each stage runs at its lower rate and only computes the
+    samples that are used, and later stages (which have a much wider transition band) need fewer coefficients.
+
+    The template parameter filtN is the number of allpass coefficients of the first (sharpest) stage at
+    STANDARD quality, e.g. filtN = 6 gives ~80dB of stopband rejection above 0.6 * baseSampleRate. ECO
+    and HIGH quality use two coefficients less or more (~54dB and ~107dB for filtN = 6), and LOW_LATENCY
+    half as many (~40dB, with less than half the group delay of STANDARD). The passband extends to
+    0.4 * baseSampleRate. Subsequent stages use the fewest coefficients that match this rejection.
+    Settled filters are bypassed as for `Oversampling`.
+*/
+template<int ratio, int filtN = 6, typename T = float>
+class HalfbandOversampling final : public BaseOversampling<T> {
+public:
+	HalfbandOversampling() = default;
+	virtual ~HalfbandOversampling() {}
+
+	void reset(float /*baseSampleRate*/) override {
+		// halfband designs don't depend on the sample rate, only the filter state needs clearing
+		for (int s = 0; s < NumStages; s++) {
+			upStages[s].reset();
+			downStages[s].reset();
+		}
+		std::fill(osBuffer, &osBuffer[ratio], 0.0f);
+		upBypass.reset();
+		downBypass.reset();
+	}
+
+	void setQuality(FilterQuality quality) override {
+		design = &getDesign(quality);
+		upBypass.reset();
+		downBypass.reset();
+	}
+
+	inline void upsample(T x) noexcept override {
+		upsampleBlock(&x, osBuffer, 1);
+	}
+
+	inline T downsample() noexcept override {
+		T y;
+		downsampleBlock(osBuffer, &y, scratch, 1);
+		return y;
+	}
+
+	inline T* getOSBuffer() noexcept override {
+		return osBuffer;
+	}
+
+	double getUpsamplingLatency() const override {
+		return getStagesLatency(*design, NumStages, false);
+	}
+
+	double getDownsamplingLatency() const override {
+		return getStagesLatency(*design, NumStages, true);
+	}
+
+	/**
+	    Theoretical magnitude response of the anti-aliasing (downsampling) filters at a given quality, with f
+	    normalised to the base sample rate (so 0.5 is the base Nyquist frequency, and ratio / 2 the oversampled one).
+	*/
+	static double getFrequencyResponse(FilterQuality quality, double f) {
+		const Design& d = getDesign(quality);
+		std::complex<double> response = 1.0;
+		for (int s = 0; s < NumStages; s++) {
+			// stage s runs at 2^(s+1) times the base rate, its second allpass path is delayed by one sample
+			const double w = 2.0 * M_PI * f / (2 << s);
+			std::complex<double> path[2] = {1.0, std::polar(1.0, -w)};
+			for (int i = 0; i < d.numCoefs[s]; i++) {
+				// (c + z^-2) / (1 + c z^-2)
+				const double c = d.coefs[s][i];
+				const double b[3] = {c, 0.0, 1.0}, a[3] = {1.0, 0.0, c};
+				IIRFilter<3, double> allpass;
+				allpass.setCoefficients(b, a);
+				path[i % 2] *= allpass.getTransferFunction(w);
+			}
+			response *= 0.5 * (path[0] + path[1]);
+		}
+		return std::abs(response);
+	}
+
+	inline void upsampleBlock(const T* x, T* osBlock, int numSamples) noexcept override {
+		if (NumStages == 0) {
+			for (int i = 0; i < numSamples; i++)
+				osBlock[i] = x[i];
+			return;
+		}
+		if (upBypass.bypass(x, numSamples, osBlock, numSamples))
+			return;
+
+		// each stage expands its input in place: the input sits at the end of the stage's output region,
+		// and is read front to back faster than the outputs are written, so nothing is overwritten early
+		const int total = ratio * numSamples;
+		T* in = &osBlock[total - numSamples];
+		for (int i = 0; i < numSamples; i++)
+			in[i] = x[i];
+
+		for (int s = 0, n = numSamples; s < NumStages; s++, n *= 2) {
+			T* out = &osBlock[total - 2 * n];
+			for (int i = 0; i < n; i++) {
+				const T v = in[i];
+				upStages[s].upsample(v, out[2 * i], out[2 * i + 1], design->coefs[s], design->numCoefs[s]);
+			}
+			in = out;
+		}
+		upBypass.track(x, numSamples);
+		if (upSnapCounter.due(numSamples)) {
+			for (int s = 0; s < NumStages; s++)
+				upStages[s].snapToZero();
+			upBypass.check(&osBlock[(numSamples - 1) * ratio]);
+		}
+	}
+
+	inline void downsampleBlock(const T* osBlock, T* y, T* scratch, int numSamples) noexcept override {
+		if (NumStages == 0) {
+			for (int i = 0; i < numSamples; i++)
+				y[i] = osBlock[i];
+			return;
+		}
+		if (downBypass.bypass(osBlock, ratio * numSamples, y, numSamples))
+			return;
+
+		// stages run in reverse order (highest rate first), intermediate results are halved in place in scratch
+		const T* src = osBlock;
+		for (int s = NumStages - 1, n = ratio / 2 * numSamples; s >= 0; s--, n /= 2) {
+			T* dst = (s == 0) ? y : scratch;
+			for (int i = 0; i < n; i++)
+				dst[i] = downStages[s].downsample(src[2 * i], src[2 * i + 1], design->coefs[s], design->numCoefs[s]);
+			src = dst;
+		}
+		downBypass.track(osBlock, ratio * numSamples);
+		if (downSnapCounter.due(numSamples)) {
+			for (int s = 0; s < NumStages; s++)
+				downStages[s].snapToZero();
+			downBypass.check(&y[numSamples - 1]);
+		}
+	}
+
+	T osBuffer[ratio];
+
+private:
+	enum {
+		NumStages = (ratio >= 16) ? 4 : (ratio >= 8) ? 3 : (ratio >= 4) ? 2 : (ratio >= 2) ? 1 : 0,
+		MaxStages = NumStages > 0 ? NumStages : 1,
+		MaxCoefs = filtN + 2, // at HIGH quality
+	};
+	static_assert(ratio == (1 << NumStages), "HalfbandOversampling ratio must be a power of two (up to 16)");
+
+	// shares the stage designs
+	template <int, int, typename>
+	friend class HalfbandDownsamplingBank;
+	template <int, int, typename>
+	friend class HalfbandUpsamplingBank;
+
+	/** Coefficients only depend on the template parameters and quality, so are shared by all instances */
+	struct Design {
+		int numCoefs[MaxStages] = {};
+		T coefs[MaxStages][MaxCoefs] = {};
+		double delay[MaxStages] = {}; // group delay at DC of each stage's filter, in samples at its higher rate
+
+		explicit Design(int firstStageCoefs) {
+			// stage s converts from 2^s to 2^(s+1) times the base rate, and the band we care about (up
+			// to 0.4 * baseSampleRate) becomes relatively narrower, so the transition band can widen
+			const double passband = 0.4;
+			const double attenuation = HalfbandDesigner::computeAttenuation(firstStageCoefs, 0.25 - passband / 2.0);
+			for (int s = 0; s < NumStages; s++) {
+				const double transition = 0.25 - passband / (2 << s);
+				numCoefs[s] = (s == 0) ? firstStageCoefs : HalfbandDesigner::computeNumCoefs(attenuation, transition, firstStageCoefs);
+
+				double stageCoefs[MaxCoefs] = {};
+				HalfbandDesigner::computeCoefs(stageCoefs, numCoefs[s], transition);
+				for (int i = 0; i < numCoefs[s]; i++)
+					coefs[s][i] = stageCoefs[i];
+
+				// an allpass section (c + z^-2) / (1 + c z^-2) delays DC by 2 (1 - c) / (1 + c) samples, and the
+				// halfband filter by the mean of its two paths (the second being a sample late)
+				double pathDelay[2] = {0.0, 1.0};
+				for (int i = 0; i < numCoefs[s]; i++)
+					pathDelay[i % 2] += 2.0 * (1.0 - stageCoefs[i]) / (1.0 + stageCoefs[i]);
+				delay[s] = 0.5 * (pathDelay[0] + pathDelay[1]);
+			}
+		}
+	};
+
+	static const Design& getDesign(FilterQuality quality) {
+		static const Design designs[NUM_QUALITIES] = {
+			Design(std::max(1, filtN - 2)), // ECO
+			Design(filtN), // STANDARD
+			Design(filtN + 2), // HIGH
+			Design(std::max(1, filtN / 2)), // LOW_LATENCY
+		};
+		return designs[quality];
+	}
+
+	/** Group delay at DC of the first `numStages` up- or downsampling stages of a design, in base rate samples */
+	static double getStagesLatency(const Design& d, int numStages, bool downsampling) {
+		double latency = 0.0;
+		for (int s = 0; s < numStages; s++) {
+			// the downsampled output is the filter's second sample of each pair, so one sample earlier
+			const double stageDelay = downsampling ? d.delay[s] - 1.0 : d.delay[s];
+			latency += stageDelay / (2 << s);
+		}
+		return latency;
+	}
+
+	const Design* design = &getDesign(STANDARD);
+	T scratch[ratio]; // for intermediate downsampling stages
+	HalfbandStage<MaxCoefs, T> upStages[MaxStages]; // anti-imaging filters
+	HalfbandStage<MaxCoefs, T> downStages[MaxStages]; // anti-aliasing filters
+	DenormalSnapCounter upSnapCounter, downSnapCounter;
+	SettledBypass<T, ratio> upBypass;
+	SettledBypass<T, 1> downBypass;
+};
+
+/**
+    Downsamples K signals at the same oversampling factor, e.g. a group of a module's outputs, with the same filters
+    as `HalfbandOversampling`. The signals are filtered together in one structure-of-arrays pass, so each allpass
+    coefficient is loaded once for all of them, and their filter states sit next to each other.
+
+    The oversampling factor is set at runtime as 2^idx (up to 16), which doesn't allocate. Signals that aren't needed
+    (e.g. unconnected outputs) can be left out of `downsample()`, their state is then left as it was. Settled signals
+    are bypassed as for `HalfbandOversampling`.
+
+    @code
+    for (int k = 0; k < K; k++) {
+        T* osBuffer = bank.getOSBuffer(k);
+        for (int i = 0; i < bank.getOversamplingRatio(); i++)
+            osBuffer[i] = processSample(k, i);
+    }
+    T y[K];
+    bank.downsample(y);
+    @endcode
+
+    Alternatively, blocks of frames can be downsampled from contiguous memory (after calling `setMaxBlockSize()`),
+    with `getOSBlockBuffer()` and `downsampleBlock()`.
+*/
+template <int K, int filtN = 6, typename T = float>
+class HalfbandDownsamplingBank {
+public:
+	HalfbandDownsamplingBank() {
+		reset();
+	}
+
+	/** Clears the filter states and oversampled buffers */
+	void reset() {
+		std::fill(&x1[0][0][0], &x1[0][0][0] + MaxStages * MaxCoefs * K, T(0.f));
+		std::fill(&y1[0][0][0], &y1[0][0][0] + MaxStages * MaxCoefs * K, T(0.f));
+		std::fill(&osBuffer[0][0], &osBuffer[0][0] + K * MaxRatio, T(0.f));
+		for (int k = 0; k < K; k++)
+			bypass[k].reset();
+	}
+
+	/** Sets the anti-aliasing filter quality, and clears the state if it changed */
+	void setQuality(FilterQuality newQuality) {
+		if (newQuality == quality)
+			return;
+		quality = newQuality;
+		design = &Cascade::getDesign(quality);
+		reset();
+	}
+
+	/** Returns the anti-aliasing filter quality */
+	FilterQuality getQuality() const noexcept {
+		return quality;
+	}
+
+	/** Sets the oversampling factor as 2^idx (clamped to 1 - 16), and clears the state if it changed */
+	void setOversamplingIndex(int newIdx) {
+		newIdx = std::max(0, std::min(newIdx, (int) MaxStages));
+		if (newIdx == numStages)
+			return;
+		numStages = newIdx;
+		reset();
+	}
+
+	/**
+	    Sets the state of signal k as if its input had long been constant at `value`, so that it carries on from there
+	    rather than from silence (e.g. from its last output, after the factor or quality changed)
+	*/
+	void settle(int k, T value) {
+		for (int s = 0; s < MaxStages; s++) {
+			for (int j = 0; j < MaxCoefs; j++) {
+				x1[s][j][k] = value;
+				y1[s][j][k] = value;
+			}
+		}
+		std::fill(osBuffer[k], osBuffer[k] + MaxRatio, value);
+		bypass[k].reset();
+	}
+
+	/**
+	    Copies the state of the first `numLanes` channels from a bank of another SIMD width with the same settings,
+	    e.g. when it hands its channels over to this one
+	*/
+	template <typename U>
+	void copyLanes(const HalfbandDownsamplingBank<K, filtN, U>& from, int numLanes) {
+		chowdsp::copyLanes(&from.x1[0][0][0], &x1[0][0][0], MaxStages * MaxCoefs * K, numLanes);
+		chowdsp::copyLanes(&from.y1[0][0][0], &y1[0][0][0], MaxStages * MaxCoefs * K, numLanes);
+		chowdsp::copyLanes(&from.osBuffer[0][0], &osBuffer[0][0], K * MaxRatio, numLanes);
+		for (int k = 0; k < K; k++)
+			bypass[k].reset();
+	}
+
+	/** Returns the oversampling index */
+	int getOversamplingIndex() const noexcept {
+		return numStages;
+	}
+
+	/** Returns the current oversampling factor */
+	int getOversamplingRatio() const noexcept {
+		return 1 << numStages;
+	}
+
+	/** Returns a pointer to the oversampled buffer of signal k */
+	inline T* getOSBuffer(int k) noexcept {
+		return osBuffer[k];
+	}
+
+	/** Group delay at DC added by `downsample()`, in base rate samples, as `HalfbandOversampling::getDownsamplingLatency()` */
+	double getDownsamplingLatency() const {
+		return Cascade::getStagesLatency(*design, numStages, true);
+	}
+
+	/** Downsamples the oversampled buffers of the signals in `mask` (bit k for signal k) to y[k] */
+	inline void downsample(T* y, int mask = (1 << K) - 1) noexcept {
+		const T* in[K];
+		for (int k = 0; k < K; k++)
+			in[k] = osBuffer[k];
+
+		switch (numStages) {
+			case 0:
+				for (int k = 0; k < K; k++) {
+					if (mask >> k & 1)
+						y[k] = osBuffer[k][0];
+				}
+				break;
+			case 1: downsampleStages<1>(in, y, mask); break;
+			case 2: downsampleStages<2>(in, y, mask); break;
+			case 3: downsampleStages<3>(in, y, mask); break;
+			default: downsampleStages<4>(in, y, mask); break;
+		}
+	}
+
+	/**
+	 * Prepares the block API for blocks of up to `newMaxBlockSize` frames.
+	 * This allocates the block buffers (sized for x16), so should not be called from the audio thread.
+	 */
+	void setMaxBlockSize(int newMaxBlockSize) {
+		maxBlockSize = newMaxBlockSize;
+		osBlock.assign(K * MaxRatio * maxBlockSize, T(0.f));
+	}
+
+	/** Returns the largest block size supported by the block API */
+	int getMaxBlockSize() const noexcept {
+		return maxBlockSize;
+	}
+
+	/** Returns a pointer to the oversampled block buffer of signal k, holding `ratio * numSamples` contiguous samples */
+	inline T* getOSBlockBuffer(int k) noexcept {
+		return &osBlock[k * MaxRatio * maxBlockSize];
+	}
+
+	/**
+	 * Downsamples `numSamples` (<= max block size) frames of the block buffers of the signals in `mask`, to
+	 * y[n * K + k] for frame n of signal k. The filters run straight off the block buffers, frame after frame.
+	 */
+	inline void downsampleBlock(T* y, int numSamples, int mask = (1 << K) - 1) noexcept {
+		switch (numStages) {
+			case 0:
+				for (int n = 0; n < numSamples; n++) {
+					for (int k = 0; k < K; k++) {
+						if (mask >> k & 1)
+							y[n * K + k] = getOSBlockBuffer(k)[n];
+					}
+				}
+				break;
+			case 1: downsampleBlockStages<1>(y, numSamples, mask); break;
+			case 2: downsampleBlockStages<2>(y, numSamples, mask); break;
+			case 3: downsampleBlockStages<3>(y, numSamples, mask); break;
+			default: downsampleBlockStages<4>(y, numSamples, mask); break;
+		}
+	}
+
+private:
+	template <int, int, typename>
+	friend class HalfbandDownsamplingBank;
+
+	// its designs hold the coefficients of every stage, which don't depend on the number of stages
+	typedef HalfbandOversampling<16, filtN, T> Cascade;
+
+	enum {
+		MaxStages = 4,
+		MaxRatio = 1 << MaxStages,
+		MaxCoefs = filtN + 2, // at HIGH quality
+	};
+
+	template <int NumStages>
+	inline void downsampleBlockStages(T* y, int numSamples, int mask) noexcept {
+		constexpr int ratio = 1 << NumStages;
+		for (int n = 0; n < numSamples; n++) {
+			const T* in[K];
+			for (int k = 0; k < K; k++)
+				in[k] = getOSBlockBuffer(k) + n * ratio;
+			downsampleStages<NumStages>(in, &y[n * K], mask);
+		}
+	}
+
+	/** Downsamples one frame, signal k's `ratio` samples being at in[k] */
+	template <int NumStages>
+	inline void downsampleStages(const T* const* in, T* y, int mask) noexcept {
+		constexpr int ratio = 1 << NumStages;
+
+		// settled signals repeat their last output, the others are listed for filtering
+		int lanes[K];
+		int numLanes = 0;
+		for (int k = 0; k < K; k++) {
+			if ((mask >> k & 1) && !bypass[k].bypass(in[k], ratio, &y[k], 1))
+				lanes[numLanes++] = k;
+		}
+
+		// with all signals listed (the usual case) the lane loops have a fixed length, so are unrolled
+		if (numLanes == K)
+			filter<NumStages, true>(in, y, lanes, K);
+		else if (numLanes > 0)
+			filter<NumStages, false>(in, y, lanes, numLanes);
+		else
+			return;
+
+		for (int l = 0; l < numLanes; l++) {
+			const int k = lanes[l];
+			bypass[k].track(in[k], ratio);
+			if (snapCounter[k].due(1)) {
+				for (int s = 0; s < NumStages; s++) {
+					for (int j = 0; j < MaxCoefs; j++) {
+						chowdsp::snapToZero(x1[s][j][k]);
+						chowdsp::snapToZero(y1[s][j][k]);
+					}
+				}
+				bypass[k].check(&y[k]);
+			}
+		}
+	}
+
+	/** Filters the listed signals (all of them if `AllLanes`) */
+	template <int NumStages, bool AllLanes>
+	inline void filter(const T* const* in, T* y, const int* lanes, int numLanes) noexcept {
+		constexpr int ratio = 1 << NumStages;
+		if (AllLanes)
+			numLanes = K;
+
+		// stages run in reverse order (highest rate first), each signal is halved in place in its scratch buffer
+		for (int s = NumStages - 1, n = ratio / 2; s >= 0; s--, n /= 2) {
+			const T* coefs = design->coefs[s];
+			const int numCoefs = design->numCoefs[s];
+			for (int i = 0; i < n; i++) {
+				T path0[K], path1[K];
+				for (int l = 0; l < numLanes; l++) {
+					const int k = AllLanes ? l : lanes[l];
+					const T* src = (s == NumStages - 1) ? in[k] : scratch[k];
+					path0[l] = src[2 * i + 1];
+					path1[l] = src[2 * i];
+				}
+				for (int j = 0; j < numCoefs; j += 2) {
+					const T c = coefs[j];
+					for (int l = 0; l < numLanes; l++)
+						path0[l] = allpass(s, j, AllLanes ? l : lanes[l], path0[l], c);
+				}
+				for (int j = 1; j < numCoefs; j += 2) {
+					const T c = coefs[j];
+					for (int l = 0; l < numLanes; l++)
+						path1[l] = allpass(s, j, AllLanes ? l : lanes[l], path1[l], c);
+				}
+				for (int l = 0; l < numLanes; l++) {
+					const int k = AllLanes ? l : lanes[l];
+					const T out = 0.5f * (path0[l] + path1[l]);
+					if (s == 0)
+						y[k] = out;
+					else
+						scratch[k][i] = out;
+				}
+			}
+		}
+	}
+
+	// first order allpass in z^-2, as in `HalfbandStage`
+	inline T allpass(int s, int j, int k, T x, T c) noexcept {
+		const T y = c * (x - y1[s][j][k]) + x1[s][j][k];
+		x1[s][j][k] = x;
+		y1[s][j][k] = y;
+		return y;
+	}
+
+	FilterQuality quality = STANDARD;
+	const typename Cascade::Design* design = &Cascade::getDesign(STANDARD);
+	int numStages = 0;
+	T osBuffer[K][MaxRatio];
+	T scratch[K][MaxRatio / 2]; // for intermediate stages
+	// filter states, for each stage and allpass coefficient the K signals are contiguous
+	T x1[MaxStages][MaxCoefs][K];
+	T y1[MaxStages][MaxCoefs][K];
+	DenormalSnapCounter snapCounter[K];
+	SettledBypass<T, 1> bypass[K];
+	// block API buffer, each signal's block one after the other, empty unless setMaxBlockSize() has been called
+	int maxBlockSize = 0;
+	std::vector<T> osBlock;
+};
+
+
+/**
+    Upsamples K signals at the same oversampling factor, e.g. a module's inputs, with the same filters as
+    `HalfbandOversampling`. As `HalfbandDownsamplingBank`, the signals are filtered together with their filter states
+    next to each other, the oversampling factor is set at runtime without allocating, and settled signals are bypassed.
+
+    Each stage's output is kept, so the signals are also available at every lower factor (2^level for levels up to the
+    oversampling index), exactly as an upsampler set to that factor would give them. Processes running at different
+    factors can then share one upsampler.
+
+    @code
+    T x[K] = ...;
+    bank.upsample(x);
+    for (int k = 0; k < K; k++) {
+        T* osBuffer = bank.getOSBuffer(k);
+        for (int i = 0; i < bank.getOversamplingRatio(); i++)
+            processSample(k, osBuffer[i]);
+    }
+    @endcode
+*/
+template <int K, int filtN = 6, typename T = float>
+class HalfbandUpsamplingBank {
+public:
+	HalfbandUpsamplingBank() {
+		reset();
+	}
+
+	/** Clears the filter states and oversampled buffers */
+	void reset() {
+		std::fill(&x1[0][0][0], &x1[0][0][0] + MaxStages * MaxCoefs * K, T(0.f));
+		std::fill(&y1[0][0][0], &y1[0][0][0] + MaxStages * MaxCoefs * K, T(0.f));
+		std::fill(&levels[0][0], &levels[0][0] + K * LevelsSize, T(0.f));
+		for (int k = 0; k < K; k++)
+			bypass[k].reset();
+	}
+
+	/** Sets the anti-aliasing filter quality, and clears the state if it changed */
+	void setQuality(FilterQuality newQuality) {
+		if (newQuality == quality)
+			return;
+		quality = newQuality;
+		design = &Cascade::getDesign(quality);
+		reset();
+	}
+
+	/** Returns the anti-aliasing filter quality */
+	FilterQuality getQuality() const noexcept {
+		return quality;
+	}
+
+	/**
+	    Sets the oversampling factor as 2^idx (clamped to 1 - 16). Each stage only depends on the ones before it, so the
+	    stages kept carry on undisturbed (as do the signals at their levels), and those added start settled at the
+	    signals' latest values.
+	*/
+	void setOversamplingIndex(int newIdx) {
+		newIdx = std::max(0, std::min(newIdx, (int) MaxStages));
+		if (newIdx == numStages)
+			return;
+		for (int k = 0; k < K; k++) {
+			// the last sample of the highest level computed so far
+			const T value = levels[k][(2 << numStages) - 2];
+			for (int s = numStages; s < newIdx; s++)
+				settleStage(s, k, value);
+		}
+		numStages = newIdx;
+		for (int k = 0; k < K; k++)
+			bypass[k].reset();
+	}
+
+	/**
+	    Sets the state of signal k as if its input had long been constant at `value`, so that it carries on from there
+	    rather than from silence (e.g. from its latest input, after the quality changed)
+	*/
+	void settle(int k, T value) {
+		for (int s = 0; s < MaxStages; s++)
+			settleStage(s, k, value);
+		std::fill(levels[k], levels[k] + LevelsSize, value);
+		bypass[k].reset();
+	}
+
+	/**
+	    Copies the state of the first `numLanes` channels from a bank of another SIMD width with the same settings,
+	    e.g. when it hands its channels over to this one
+	*/
+	template <typename U>
+	void copyLanes(const HalfbandUpsamplingBank<K, filtN, U>& from, int numLanes) {
+		chowdsp::copyLanes(&from.x1[0][0][0], &x1[0][0][0], MaxStages * MaxCoefs * K, numLanes);
+		chowdsp::copyLanes(&from.y1[0][0][0], &y1[0][0][0], MaxStages * MaxCoefs * K, numLanes);
+		chowdsp::copyLanes(&from.levels[0][0], &levels[0][0], K * LevelsSize, numLanes);
+		for (int k = 0; k < K; k++)
+			bypass[k].reset();
+	}
+
+	/** Returns the oversampling index */
+	int getOversamplingIndex() const noexcept {
+		return numStages;
+	}
+
+	/** Returns the current oversampling factor */
+	int getOversamplingRatio() const noexcept {
+		return 1 << numStages;
+	}
+
+	/** Returns a pointer to the oversampled buffer of signal k */
+	inline T* getOSBuffer(int k) noexcept {
+		return getOSBuffer(k, numStages);
+	}
+
+	/** Returns a pointer to the buffer of signal k at 2^level times the base rate (level up to the oversampling index) */
+	inline T* getOSBuffer(int k, int level) noexcept {
+		return &levels[k][(1 << level) - 1];
+	}
+
+	/** Group delay at DC added by `upsample()`, in base rate samples, as `HalfbandOversampling::getUpsamplingLatency()` */
+	double getUpsamplingLatency() const {
+		return getUpsamplingLatency(numStages);
+	}
+
+	/** Group delay at DC of the signals at 2^level times the base rate (once upsampled that far), in base rate samples */
+	double getUpsamplingLatency(int level) const {
+		return Cascade::getStagesLatency(*design, std::max(0, std::min(level, (int) MaxStages)), false);
+	}
+
+	/** Upsamples one sample of each signal, x[k], to the oversampled buffers */
+	inline void upsample(const T* x) noexcept {
+		switch (numStages) {
+			case 0:
+				for (int k = 0; k < K; k++)
+					levels[k][0] = x[k];
+				break;
+			case 1: upsampleStages<1>(x); break;
+			case 2: upsampleStages<2>(x); break;
+			case 3: upsampleStages<3>(x); break;
+			default: upsampleStages<4>(x); break;
+		}
+	}
+
+private:
+	template <int, int, typename>
+	friend class HalfbandUpsamplingBank;
+
+	// its designs hold the coefficients of every stage, which don't depend on the number of stages
+	typedef HalfbandOversampling<16, filtN, T> Cascade;
+
+	enum {
+		MaxStages = 4,
+		MaxRatio = 1 << MaxStages,
+		MaxCoefs = filtN + 2, // at HIGH quality
+		LevelsSize = 2 * MaxRatio - 1, // the buffers of each level (1, 2, 4 ... 16 samples) one after the other
+	};
+
+	template <int NumStages>
+	inline void upsampleStages(const T* x) noexcept {
+		// settled signals repeat their last output, the others are listed for filtering
+		int lanes[K];
+		int numLanes = 0;
+		for (int k = 0; k < K; k++) {
+			if (!bypass[k].bypass(&x[k], 1, levels[k], 1))
+				lanes[numLanes++] = k;
+		}
+
+		// with all signals listed (the usual case) the lane loops have a fixed length, so are unrolled
+		if (numLanes == K)
+			filter<NumStages, true>(x, lanes, K);
+		else if (numLanes > 0)
+			filter<NumStages, false>(x, lanes, numLanes);
+		else
+			return;
+
+		for (int l = 0; l < numLanes; l++) {
+			const int k = lanes[l];
+			bypass[k].track(&x[k], 1);
+			if (snapCounter[k].due(1)) {
+				for (int s = 0; s < NumStages; s++) {
+					for (int j = 0; j < MaxCoefs; j++) {
+						chowdsp::snapToZero(x1[s][j][k]);
+						chowdsp::snapToZero(y1[s][j][k]);
+					}
+				}
+				bypass[k].check(levels[k]);
+			}
+		}
+	}
+
+	/** Filters the listed signals (all of them if `AllLanes`) */
+	template <int NumStages, bool AllLanes>
+	inline void filter(const T* x, const int* lanes, int numLanes) noexcept {
+		if (AllLanes)
+			numLanes = K;
+
+		for (int l = 0; l < numLanes; l++) {
+			const int k = AllLanes ? l : lanes[l];
+			levels[k][0] = x[k];
+		}
+		// stage s expands level s (n samples) to level s + 1
+		for (int s = 0, n = 1; s < NumStages; s++, n *= 2) {
+			const T* coefs = design->coefs[s];
+			const int numCoefs = design->numCoefs[s];
+			for (int i = 0; i < n; i++) {
+				T path0[K], path1[K];
+				for (int l = 0; l < numLanes; l++) {
+					const int k = AllLanes ? l : lanes[l];
+					path0[l] = path1[l] = levels[k][n - 1 + i];
+				}
+				for (int j = 0; j < numCoefs; j += 2) {
+					const T c = coefs[j];
+					for (int l = 0; l < numLanes; l++)
+						path0[l] = allpass(s, j, AllLanes ? l : lanes[l], path0[l], c);
+				}
+				for (int j = 1; j < numCoefs; j += 2) {
+					const T c = coefs[j];
+					for (int l = 0; l < numLanes; l++)
+						path1[l] = allpass(s, j, AllLanes ? l : lanes[l], path1[l], c);
+				}
+				for (int l = 0; l < numLanes; l++) {
+					const int k = AllLanes ? l : lanes[l];
+					levels[k][2 * n - 1 + 2 * i] = path0[l];
+					levels[k][2 * n - 1 + 2 * i + 1] = path1[l];
+				}
+			}
+		}
+	}
+
+	// at a constant input each allpass outputs that input, so this is the state it settles to
+	void settleStage(int s, int k, T value) {
+		for (int j = 0; j < MaxCoefs; j++) {
+			x1[s][j][k] = value;
+			y1[s][j][k] = value;
+		}
+	}
+
+	// first order allpass in z^-2, as in `HalfbandStage`
+	inline T allpass(int s, int j, int k, T x, T c) noexcept {
+		const T y = c * (x - y1[s][j][k]) + x1[s][j][k];
+		x1[s][j][k] = x;
+		y1[s][j][k] = y;
+		return y;
+	}
+
+	FilterQuality quality = STANDARD;
+	const typename Cascade::Design* design = &Cascade::getDesign(STANDARD);
+	int numStages = 0;
+	T levels[K][LevelsSize];
+	// filter states, for each stage and allpass coefficient the K signals are contiguous
+	T x1[MaxStages][MaxCoefs][K];
+	T y1[MaxStages][MaxCoefs][K];
+	DenormalSnapCounter snapCounter[K];
+	// the held output frame is all the levels (of the largest factor), so doesn't depend on the current one
+	SettledBypass<T, LevelsSize> bypass[K];
+};
+
+/**
+ * Returns the smallest oversampling index whose oversampled rate reaches `targetRate` at a given base sample rate
+ * (clamped to x16, the largest factor of the halfband banks), e.g. for a target of 176.4kHz: x4 at 44.1kHz and 48kHz,
+ * x1 at 192kHz.
+ */
+inline int getOversamplingIndexForRate(float sampleRate, float targetRate) {
+	const int maxIndex = 4;
+	int idx = 0;
+	while (idx < maxIndex && (sampleRate * (1 << idx)) < targetRate) {
+		idx++;
+	}
+	return idx;
+}
+
 /**
     Class to implement an oversampled process, with variable
     oversampling factor. To use, create an object, set the oversampling
@@ -363,63 +1665,230 @@ typedef Oversampling<1, 4, simd::float_4> OversamplingSIMD;
     float y = oversample.downsample();
     @endcode
 
+    Alternatively, blocks of frames can be processed over contiguous memory (after calling `setMaxBlockSize()`):
+    @code
+    oversample.upsampleBlock(x, numSamples);
+    float* osBlock = oversample.getOSBlockBuffer();
+    for(int k = 0; k < ratio * numSamples; k++)
+        osBlock[k] = processSample(osBlock[k]);
+    oversample.downsampleBlock(y, numSamples);
+    @endcode
+
+    The oversampler implementation can be chosen with the OversamplingType template parameter,
+    e.g. `Oversampling` (Butterworth filters) or `HalfbandOversampling` (polyphase halfband cascade).
+    Either way, `setQuality()` trades the filters' stopband rejection against CPU.
+
+    Only the oversampler for the active factor is allocated, when the factor is set. As that allocates,
+    `setOversamplingIndex()` should be called from outside the audio thread. The audio thread acknowledges the
+    oversampler it uses, so one it may still be in is kept until it has moved on to the new one.
+
 	source (modified): https://github.com/jatinchowdhury18/ChowDSP-VCV/blob/master/src/shared/VariableOversampling.hpp
 */
-template<int filtN = 4, typename T = float>
+template<int filtN = 4, typename T = float, template<int, int, typename> class OversamplingType = Oversampling>
 class VariableOversampling {
 public:
-	VariableOversampling() = default;
+	VariableOversampling() {
+		setOversamplingIndex(0);
+	}
 
 	/** Prepare the oversampler to process audio at a given sample rate */
-	void reset(float sampleRate) {
-		for (auto* os : oss)
-			os->reset(sampleRate);
+	void reset(float newSampleRate) {
+		sampleRate = newSampleRate;
+		for (auto& os : oss) {
+			if (os) {
+				os->reset(sampleRate);
+			}
+		}
+	}
+
+	/** Sets the anti-aliasing filter quality (of the current and any future oversamplers) */
+	void setQuality(FilterQuality newQuality) {
+		quality = newQuality;
+		for (auto& os : oss) {
+			if (os) {
+				os->setQuality(quality);
+			}
+		}
+	}
+
+	/** Returns the anti-aliasing filter quality */
+	FilterQuality getQuality() const noexcept {
+		return quality;
 	}
 
-	/** Sets the oversampling factor as 2^idx */
+	/**
+	 * Sets the oversampling factor as 2^idx, allocating its oversampler if needed. The others are freed, other than
+	 * the one the audio thread has acknowledged (it may still be using it, until its next call after this).
+	 */
 	void setOversamplingIndex(int newIdx) {
-		osIdx = newIdx;
+		newIdx = std::max(0, std::min(newIdx, NumOS - 1));
+		if (!oss[newIdx]) {
+			oss[newIdx] = makeOversampler(newIdx);
+			oss[newIdx]->setQuality(quality);
+			oss[newIdx]->reset(sampleRate);
+		}
+
+		// publish only once the oversampler is ready. Both this and acknowledge() store then load (sequentially
+		// consistent), so either the audio thread sees the new index, or the index it uses is seen here
+		osIdx.store(newIdx);
+		const int inUse = usedIdx.load();
+		for (int i = 0; i < NumOS; i++) {
+			if (i != newIdx && i != inUse) {
+				oss[i].reset();
+			}
+		}
 	}
 
 	/** Returns the oversampling index */
 	int getOversamplingIndex() const noexcept {
-		return osIdx;
+		return osIdx.load(std::memory_order_relaxed);
 	}
 
 	/** Upsample a single input sample and update the oversampled buffer */
 	inline void upsample(T x) noexcept {
-		oss[osIdx]->upsample(x);
+		dispatch([&](auto & os) {
+			os.upsample(x);
+		});
 	}
 
 	/** Output a downsampled output sample from the current oversampled buffer */
 	inline T downsample() noexcept {
-		return oss[osIdx]->downsample();
+		return dispatch([](auto & os) {
+			return os.downsample();
+		});
 	}
 
 	/** Returns a pointer to the oversampled buffer */
 	inline T* getOSBuffer() noexcept {
-		return oss[osIdx]->getOSBuffer();
+		return dispatch([](auto & os) {
+			return os.getOSBuffer();
+		});
 	}
 
 	/** Returns the current oversampling factor */
 	int getOversamplingRatio() const noexcept {
-		return 1 << osIdx;
+		return 1 << getOversamplingIndex();
+	}
+
+	/** Group delay at DC added by upsampling at the current factor and quality, in base rate samples */
+	double getUpsamplingLatency() const {
+		return oss[getOversamplingIndex()]->getUpsamplingLatency();
+	}
+
+	/** Group delay at DC added by downsampling at the current factor and quality, in base rate samples */
+	double getDownsamplingLatency() const {
+		return oss[getOversamplingIndex()]->getDownsamplingLatency();
+	}
+
+	/** Group delay at DC of an oversampled process (upsampling then downsampling), in base rate samples */
+	double getLatency() const {
+		return oss[getOversamplingIndex()]->getLatency();
+	}
+
+	/**
+	 * Prepares the block API for blocks of up to `newMaxBlockSize` frames.
+	 * This allocates the internal block buffers, so should not be called from the audio thread.
+	 */
+	void setMaxBlockSize(int newMaxBlockSize) {
+		maxBlockSize = newMaxBlockSize;
+		// sized for the largest ratio, so changing the oversampling index never reallocates
+		osBlock.assign(MaxRatio * maxBlockSize, T(0.f));
+		scratchBlock.assign(MaxRatio / 2 * maxBlockSize, T(0.f));
+	}
+
+	/** Returns the largest block size supported by the block API */
+	int getMaxBlockSize() const noexcept {
+		return maxBlockSize;
+	}
+
+	/** Upsample `numSamples` (<= max block size) input samples into the oversampled block buffer */
+	inline void upsampleBlock(const T* x, int numSamples) noexcept {
+		dispatch([&](auto & os) {
+			os.upsampleBlock(x, osBlock.data(), numSamples);
+		});
+	}
+
+	/** Output `numSamples` downsampled samples from the current oversampled block buffer */
+	inline void downsampleBlock(T* y, int numSamples) noexcept {
+		dispatch([&](auto & os) {
+			os.downsampleBlock(osBlock.data(), y, scratchBlock.data(), numSamples);
+		});
+	}
+
+	/** Returns a pointer to the oversampled block buffer, holding `ratio * numSamples` contiguous samples */
+	inline T* getOSBlockBuffer() noexcept {
+		return osBlock.data();
 	}
 
 
 private:
 	enum {
 		NumOS = 5, // number of oversampling options
+		MaxRatio = 1 << (NumOS - 1),
 	};
 
-	int osIdx = 0;
+	std::atomic<int> osIdx{0};
+	// the index the audio thread has acknowledged, its oversampler isn't freed
+	std::atomic<int> usedIdx{0};
+	float sampleRate = 44100.f;
+	FilterQuality quality = STANDARD;
+
+	// oversamplers for each factor, only allocated when selected
+	std::unique_ptr<BaseOversampling<T>> oss[NumOS];
+
+	template <int idx>
+	using OversamplerType = OversamplingType < 1 << idx, filtN, T >;
+
+	static std::unique_ptr<BaseOversampling<T>> makeOversampler(int idx) {
+		switch (idx) {
+			case 0: return std::make_unique<OversamplerType<0>>(); // 1x
+			case 1: return std::make_unique<OversamplerType<1>>(); // 2x
+			case 2: return std::make_unique<OversamplerType<2>>(); // 4x
+			case 3: return std::make_unique<OversamplerType<3>>(); // 8x
+			default: return std::make_unique<OversamplerType<4>>(); // 16x
+		}
+	}
+
+	template <int idx>
+	inline OversamplerType<idx>& get() noexcept {
+		return static_cast<OversamplerType<idx>&>(*oss[idx]);
+	}
+
+	/**
+	 * Calls `f` with the active oversampler. Each case sees the concrete (final) oversampler type, so
+	 * the compiler can inline its methods rather than making a virtual call per sample.
+	 */
+	template <typename F>
+	inline decltype(auto) dispatch(F&& f) noexcept {
+		int idx = osIdx.load(std::memory_order_acquire);
+		if (idx != usedIdx.load(std::memory_order_relaxed)) {
+			idx = acknowledge();
+		}
+		switch (idx) {
+			case 0: return f(get<0>());
+			case 1: return f(get<1>());
+			case 2: return f(get<2>());
+			case 3: return f(get<3>());
+			default: return f(get<4>());
+		}
+	}
+
+	/** Marks the published index as in use (on the audio thread, when it changes), and returns it */
+	__attribute__((noinline)) int acknowledge() noexcept {
+		int idx = osIdx.load();
+		int seen;
+		do {
+			seen = idx;
+			usedIdx.store(seen);
+			idx = osIdx.load();
+		} while (idx != seen);
+		return idx;
+	}
 
-	Oversampling < 1 << 0, filtN, T > os0; // 1x
-	Oversampling < 1 << 1, filtN, T > os1; // 2x
-	Oversampling < 1 << 2, filtN, T > os2; // 4x
-	Oversampling < 1 << 3, filtN, T > os3; // 8x
-	Oversampling < 1 << 4, filtN, T > os4; // 16x
-	BaseOversampling<T>* oss[NumOS] = { &os0, &os1, &os2, &os3, &os4 };
+	// block API buffers, empty unless setMaxBlockSize() has been called
+	int maxBlockSize = 0;
+	std::vector<T> osBlock;
+	std::vector<T> scratchBlock;
 };
 
 } // namespace chowdsp
@@ -1,7 +1,12 @@
 #include "plugin.hpp"
 #include "ChowDSP.hpp"
+#include "float_8.hpp"
+#include "CosmosLogic.hpp"
+#include <array>
+#include <utility>
 
 using namespace simd;
+using simd8::float_8;
 
 struct Cosmos : Module {
 	enum ParamId {
@@ -59,37 +64,226 @@ struct Cosmos : Module {
 		LIGHTS_LEN
 	};
 
-	// for outputting triggers
-	PulseGenerator_4 logicalOrPulseGenerator[4];
-	PulseGenerator_4 logicalAndPulseGenerator[4];
-	PulseGenerator_4 logicalXorPulseGenerator[4];
-	PulseGenerator_4 logicalNorPulseGenerator[4];
-	PulseGenerator_4 logicalNandPulseGenerator[4];
-	PulseGenerator_4 logicalXnorPulseGenerator[4];
-
-	dsp::TSchmittTrigger<float_4> logicalOrGate[4];
-	dsp::TSchmittTrigger<float_4> logicalAndGate[4];
-	dsp::TSchmittTrigger<float_4> logicalXorGate[4];
-	dsp::TSchmittTrigger<float_4> logicalNorGate[4];
-	dsp::TSchmittTrigger<float_4> logicalNandGate[4];
-	dsp::TSchmittTrigger<float_4> logicalXnorGate[4];
+	// signals of the output groups' downsampling banks
+	enum LogicSignal {
+		OR_SIGNAL,
+		AND_SIGNAL,
+		XOR_SIGNAL,
+		NUM_LOGIC_SIGNALS
+	};
+	enum TriggerSignal {
+		OR_TRIG_SIGNAL,
+		NOR_TRIG_SIGNAL,
+		AND_TRIG_SIGNAL,
+		NAND_TRIG_SIGNAL,
+		XOR_TRIG_SIGNAL,
+		XNOR_TRIG_SIGNAL,
+		NUM_TRIGGER_SIGNALS
+	};
+	static constexpr OutputId triggerOutputIds[NUM_TRIGGER_SIGNALS] = {
+		OR_TRIG_OUTPUT, NOR_TRIG_OUTPUT, AND_TRIG_OUTPUT, NAND_TRIG_OUTPUT, XOR_TRIG_OUTPUT, XNOR_TRIG_OUTPUT
+	};
+	static constexpr OutputId gateOutputIds[NUM_LOGIC_SIGNALS] = {OR_GATE_OUTPUT, AND_GATE_OUTPUT, XOR_GATE_OUTPUT};
+	static constexpr OutputId invertedGateOutputIds[NUM_LOGIC_SIGNALS] = {NOR_GATE_OUTPUT, NAND_GATE_OUTPUT, XNOR_GATE_OUTPUT};
+
+	// groups of outputs with their own oversampling rate (the inverted outputs follow their non-inverted ones)
+	enum OversamplingGroup {
+		MIN_MAX_GROUP,		// OR and AND
+		XOR_GROUP,
+		GATE_GROUP,
+		TRIGGER_GROUP,
+		NUM_OVERSAMPLING_GROUPS
+	};
+	static constexpr int minMaxSignals = 1 << OR_SIGNAL | 1 << AND_SIGNAL;
+	// the settings of every group, handed to the audio thread together
+	struct GroupOversamplingSettings {
+		OversamplingSettings groups[NUM_OVERSAMPLING_GROUPS];
+	};
+
+	// per-channel state, for polyphony channels processed in blocks of T::size (float_4, or float_8 with AVX2)
+	template <typename T>
+	struct Engine {
+		static constexpr int numBlocks = PORT_MAX_CHANNELS / T::size;
+
+		// for outputting triggers, Schmitt triggers and pulse generators of each TriggerSignal
+		TTriggerPulseBank<T, NUM_TRIGGER_SIGNALS> triggerBank[numBlocks];
+
+		// oversampling of one block of channels, kept together: only X and Y are upsampled, and the outputs of a group
+		// are downsampled together (the direct outputs, and the inverted ones derived after downsampling, need none).
+		// These are fixed size, so changing the oversampling factor doesn't allocate
+		struct Oversamplers {
+			// polyphase halfband cascade (~80dB rejection) to the highest group rate, each group reads its own rate's level
+			chowdsp::HalfbandUpsamplingBank<2, 6, T> xy;
+			chowdsp::HalfbandDownsamplingBank<2, 6, T> minMax; 	// OR_SIGNAL, AND_SIGNAL
+			chowdsp::HalfbandDownsamplingBank<1, 6, T> exclusiveOr;
+			chowdsp::HalfbandDownsamplingBank<NUM_LOGIC_SIGNALS, 6, T> gates;
+			chowdsp::HalfbandDownsamplingBank<NUM_TRIGGER_SIGNALS, 6, T> triggers;
+		};
+		Oversamplers oversamplers[numBlocks];
+		// alternatives to oversampling the logic outputs, and the gates and triggers
+		cosmos::LogicADAA<T> logicADAA[numBlocks];
+		TPolyBlepGate<T> polyBlepGate[NUM_LOGIC_SIGNALS][numBlocks];
+		TPolyBlepPulse<T> polyBlepTrigger[NUM_TRIGGER_SIGNALS][numBlocks];
+		// to align the direct (X/Y derived) outputs with the oversampled ones. Up to 14 samples, well over the largest
+		// logic latency (5.7 samples, at x16 with High quality)
+		TFractionalDelay<T, 16> xDelay[numBlocks];
+		TFractionalDelay<T, 16> yDelay[numBlocks];
+		// blocks whose X/Y have been constant for long enough are skipped, keeping their outputs
+		TBlockActivity<T, 2> activity[numBlocks];
+
+		// clears all state
+		void reset() {
+			for (int b = 0; b < numBlocks; b++) {
+				oversamplers[b].xy.reset();
+				oversamplers[b].minMax.reset();
+				oversamplers[b].exclusiveOr.reset();
+				oversamplers[b].gates.reset();
+				oversamplers[b].triggers.reset();
+				logicADAA[b].reset();
+				for (int k = 0; k < NUM_LOGIC_SIGNALS; k++) {
+					polyBlepGate[k][b].reset();
+				}
+				for (int k = 0; k < NUM_TRIGGER_SIGNALS; k++) {
+					polyBlepTrigger[k][b].reset();
+				}
+				xDelay[b].reset();
+				yDelay[b].reset();
+				triggerBank[b].reset();
+				activity[b].wake();
+			}
+		}
+
+		// takes over from an engine of the other width. The engines swap between 4 and 5 channels, so the channels
+		// running before and after are among the first four, which carry on from where they were. The others start afresh
+		template <typename U>
+		void takeOver(const Engine<U>& from) {
+			static_assert(T::size >= 4 && U::size >= 4, "the first four channels are in the first block of either engine");
+			reset();
+			auto& o = oversamplers[0];
+			const auto& fromO = from.oversamplers[0];
+			o.xy.copyLanes(fromO.xy, 4);
+			o.minMax.copyLanes(fromO.minMax, 4);
+			o.exclusiveOr.copyLanes(fromO.exclusiveOr, 4);
+			o.gates.copyLanes(fromO.gates, 4);
+			o.triggers.copyLanes(fromO.triggers, 4);
+			logicADAA[0].copyLanes(from.logicADAA[0], 4);
+			for (int k = 0; k < NUM_LOGIC_SIGNALS; k++) {
+				polyBlepGate[k][0].copyLanes(from.polyBlepGate[k][0], 4);
+			}
+			for (int k = 0; k < NUM_TRIGGER_SIGNALS; k++) {
+				polyBlepTrigger[k][0].copyLanes(from.polyBlepTrigger[k][0], 4);
+			}
+			xDelay[0].copyLanes(from.xDelay[0], 4);
+			yDelay[0].copyLanes(from.yDelay[0], 4);
+			triggerBank[0].copyLanes(from.triggerBank[0], 4);
+			activity[0].copyLanes(from.activity[0], 4);
+		}
+	};
+	Engine<float_4> engine4;
+#ifdef SIMD8_AVX2
+	// if the CPU supports AVX2, 8 channel blocks are used with more than 4 channels (with fewer, half of each block would
+	// be idle). Only allocated if so, by the constructor
+	std::unique_ptr<Engine<float_8>> engine8;
+	bool engine8Active = false;
+#endif
+
+	// menu entry after the fixed oversampling rates
+	static constexpr int AUTO_OVERSAMPLING_MODE = 5;
 
 	dsp::BooleanTrigger xButtonTrigger;
 	dsp::BooleanTrigger yButtonTrigger;
 
-	// oversampling
-	chowdsp::VariableOversampling<6, float_4> oversampler[OUTPUTS_LEN][PORT_MAX_CHANNELS / 4]; 	// uses a 2*6=12th order Butterworth filter
-	int oversamplingIndex = 2; 	// default is 2^oversamplingIndex == x4 oversampling
-	bool oversampleLogicOutputs = true;
-	bool oversampleLogicGateOutputs = false;
-	bool oversampleLogicTriggerOutputs = false;
+	// 2^oversamplingIndex is each group's factor, by default x4 for the logic outputs and off for the gates and triggers
+	int oversamplingIndex[NUM_OVERSAMPLING_GROUPS] = {2, 2, 0, 0};
+	// if set, the group's index is chosen to reach autoOversamplingRate
+	bool autoOversampling[NUM_OVERSAMPLING_GROUPS] = {};
+	int oversamplingQuality = chowdsp::STANDARD;
+	// antiderivative anti-aliasing of the logic outputs at the base rate, instead of oversampling them
+	bool adaaLogicOutputs = false;
+	// gates and triggers at the base rate with sub-sample edge timing and polyBLEP corrected edges, instead of oversampling them
+	bool polyBlepGateOutputs = false;
+	// delay the direct outputs (X, Y, sum, difference and inverses) by the oversampling latency
+	bool alignDirectOutputs = false;
+	// group delay of each group's oversampled outputs, in samples
+	float oversamplingLatency[NUM_OVERSAMPLING_GROUPS] = {};
+	// the delay of the direct outputs, following getDirectDelay() by at most directDelaySlew samples per frame so that a
+	// change (e.g. of oversampling rate, while the switch fades the logic outputs back in) bends their pitch by 2% for
+	// a few milliseconds rather than clicking
+	float directDelay = 0.f;
+	static constexpr float directDelaySlew = 0.02f;
+	// hands changes of the above oversampling settings to the audio thread
+	TOversamplingSwitch<GroupOversamplingSettings> oversamplingSwitch;
 
 	bool clip10V = true;
 
+	// how the logic outputs are produced, a compile time parameter of the kernels
+	enum LogicMode {
+		LOGIC_BASE_RATE,		// also when none are connected (the LEDs still read them)
+		LOGIC_OVERSAMPLED,		// each logic group at its own rate, some of which may be 1
+		LOGIC_ADAA,
+		NUM_LOGIC_MODES
+	};
+	// how the gates are produced, a compile time parameter of the kernels
+	enum GateMode {
+		GATES_OFF,				// no gate or trigger output connected
+		GATES_BASE_RATE,
+		GATES_OVERSAMPLED,		// gates and triggers each at their group's rate, some of which may be 1
+		GATES_POLYBLEP,			// gates and triggers at the base rate, see processPolyBlepGates()
+		NUM_GATE_MODES
+	};
+
+	// the stages that the connected outputs depend on, rebuilt when the connections or settings change
+	struct Dataflow {
+		LogicMode logicMode = LOGIC_BASE_RATE;
+		GateMode gateMode = GATES_OFF;
+		bool triggers = false; 		// trigger outputs, other than polyBLEP ones, are run
+		int logicMask = 0; 			// logic signals with a connected (analogue or inverted) output
+		int gateOutputMask = 0; 	// gate signals with a connected (normal or inverted) output
+		int gateMask = 0; 			// gate signals needed, by their outputs or by the triggers derived from them
+		int triggerMask = 0; 		// trigger signals with a connected output
+		int groupMask = 0; 			// groups with a connected output, 1 << OversamplingGroup
+	};
+	Dataflow dataflow;
+	uint32_t dataflowKey = ~0u;
+
+	// values for one frame, shared by all blocks of channels
+	struct Frame {
+		int numChannels;
+		float xPad, yPad;
+		float threshold;
+		float clipLimit; 	// 10V, or infinity if not clipping
+		// 2^level is the rate each group is computed at (0 for a group with nothing connected, as it's discarded)
+		int level[NUM_OVERSAMPLING_GROUPS];
+		float oversampledGain; 	// of the oversampled logic outputs against the base rate ones, 1 unless switching
+		float directDelay;
+		float sampleTime;
+		bool wake; 	// process every block, even those that have been idle, as something shared by all of them changed
+
+		// whether everything shared by the blocks is the same (other than the pads, which reach them through X/Y)
+		bool sameSettings(const Frame& other) const {
+			return numChannels == other.numChannels
+			       && threshold == other.threshold
+			       && clipLimit == other.clipLimit
+			       && std::equal(level, level + NUM_OVERSAMPLING_GROUPS, other.level)
+			       && oversampledGain == other.oversampledGain
+			       && directDelay == other.directDelay
+			       && sampleTime == other.sampleTime;
+		}
+	};
+	Frame lastFrame = {};
+	// set when the oversampling or the kernels change, which all blocks have to see
+	bool wakeBlocks = true;
+	// the kernel specialised for the dataflow, per engine (set by updateDataflow(), which runs before the first frame)
+	typedef void (Cosmos::*Kernel)(const Frame& frame);
+	Kernel kernel4 = nullptr;
+#ifdef SIMD8_AVX2
+	Kernel kernel8 = nullptr;
+#endif
+
 	ParamQuantity* thresholdTrimmerQuantity{};
 	ParamQuantity* pressureMaxQuantity{};
-	// pressure for two pads (X, Y)
-	float pressure[2] = {};
+	// pressure for two pads (X, Y), from the pads' drag gestures on the UI thread
+	ControlEventStream pressure[2];
 
 	Cosmos() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
@@ -126,189 +320,203 @@ struct Cosmos : Module {
 		configOutput(XNOR_OUTPUT, "XNOR (inverted through-zero clipper)");
 		configOutput(XNOR_GATE_OUTPUT, "XNOR gate");
 		configOutput(XNOR_TRIG_OUTPUT, "XNOR trigger");
-	}
 
-	void onSampleRateChange() override {
-		float sampleRate = APP->engine->getSampleRate();
-		for (int outputId = 0; outputId < OUTPUTS_LEN; outputId++) {
-			for (int c = 0; c < PORT_MAX_CHANNELS; c += 4) {
-				oversampler[outputId][c / 4].setOversamplingIndex(oversamplingIndex);
-				oversampler[outputId][c / 4].reset(sampleRate);
-			}
+#ifdef SIMD8_AVX2
+		if (useAVX2Kernels) {
+			engine8.reset(new Engine<float_8>());
 		}
+#endif
 	}
 
-	void process(const ProcessArgs& args) override {
-
-		const int numActivePolyphonyChannels = std::max({1, inputs[X_INPUT].getChannels(), inputs[Y_INPUT].getChannels()});
-		xButtonTrigger.process(params[PAD_X_PARAM].getValue());
-		yButtonTrigger.process(params[PAD_Y_PARAM].getValue());
+	void onSampleRateChange() override {
+		// process() isn't running meanwhile, so the settings are applied at once (superseding any queued ones)
+		oversamplingSwitch.reset();
+		applyOversampling(getOversamplingSettings(), APP->engine->getSampleRate());
+	}
 
-		const float_4 xPad = params[PRESSURE_PARAM].getValue() * pressure[PAD_X_PARAM] * xButtonTrigger.isHigh();
-		const float_4 yPad = params[PRESSURE_PARAM].getValue() * pressure[PAD_Y_PARAM] * yButtonTrigger.isHigh();
+	// the settings as chosen in the menu, which only process() applies to the oversamplers
+	GroupOversamplingSettings getOversamplingSettings() const {
+		GroupOversamplingSettings settings;
+		for (int g = 0; g < NUM_OVERSAMPLING_GROUPS; g++) {
+			settings.groups[g].index = oversamplingIndex[g];
+			settings.groups[g].autoRate = autoOversampling[g];
+			settings.groups[g].quality = oversamplingQuality;
+		}
+		return settings;
+	}
 
-		const float_4 threshold = params[THRESHOLD_PARAM].getValue();
-		const int oversamplingRatio = oversampler[OR_OUTPUT][0].getOversamplingRatio();
+	// called from the menu (UI thread) after changing the settings
+	void requestOversampling() {
+		oversamplingSwitch.request(getOversamplingSettings());
+	}
 
-		// trigger oversampling neccessitates gate oversampling
-		if (oversampleLogicTriggerOutputs) {
-			oversampleLogicGateOutputs = true;
+	// configures the oversamplers, from the audio thread (or while it isn't running), which doesn't allocate. Only the
+	// banks whose factor or quality changed are touched, the others carry on undisturbed
+	void applyOversampling(const GroupOversamplingSettings& settings, float sampleRate) {
+		int index[NUM_OVERSAMPLING_GROUPS];
+		for (int g = 0; g < NUM_OVERSAMPLING_GROUPS; g++) {
+			index[g] = settings.groups[g].autoRate
+			           ? chowdsp::getOversamplingIndexForRate(sampleRate, autoOversamplingRate)
+			           : settings.groups[g].index;
 		}
-		// gate oversampling neccessitates logic outputs oversampling
-		if (oversampleLogicGateOutputs) {
-			oversampleLogicOutputs = true;
+		// the quality is shared by all groups
+		const chowdsp::FilterQuality quality = (chowdsp::FilterQuality) settings.groups[0].quality;
+		configureOversamplers(engine4, index, quality);
+#ifdef SIMD8_AVX2
+		if (engine8) {
+			configureOversamplers(*engine8, index, quality);
 		}
-		// disable oversampling if ratio is 1 (off)
-		if (oversamplingRatio == 1) {
-			oversampleLogicOutputs = false;
-			oversampleLogicGateOutputs = false;
-			oversampleLogicTriggerOutputs = false;
+#endif
+		configureUpsampling();
+		wakeBlocks = true;
+		// each group reads the upsampled X/Y at its own rate, so has the latency of that part of the cascade
+		const auto& oversamplers = engine4.oversamplers[0];
+		oversamplingLatency[MIN_MAX_GROUP] = oversamplers.minMax.getDownsamplingLatency();
+		oversamplingLatency[XOR_GROUP] = oversamplers.exclusiveOr.getDownsamplingLatency();
+		oversamplingLatency[GATE_GROUP] = oversamplers.gates.getDownsamplingLatency();
+		oversamplingLatency[TRIGGER_GROUP] = oversamplers.triggers.getDownsamplingLatency();
+		for (int g = 0; g < NUM_OVERSAMPLING_GROUPS; g++) {
+			oversamplingLatency[g] += oversamplers.xy.getUpsamplingLatency(getOversamplingIndex(g));
 		}
+	}
 
-		// loop over polyphony channels in blocks of 4
-		for (int c = 0; c < numActivePolyphonyChannels; c += 4) {
-			// x, y are normalled to the pad inputs
-			const float_4 x = inputs[X_INPUT].getNormalPolyVoltageSimd<float_4>(xPad, c);
-			const float_4 y = inputs[Y_INPUT].getNormalPolyVoltageSimd<float_4>(yPad, c);
-
-			// basic main outputs
-			outputs[X_OUTPUT].setVoltageSimd<float_4>(x, c);
-			outputs[Y_OUTPUT].setVoltageSimd<float_4>(y, c);
-			outputs[SUM_OUTPUT].setVoltageSimd<float_4>(0.5 * (x + y), c);
-			// basic inverse outputs
-			outputs[INV_X_OUTPUT].setVoltageSimd<float_4>(-x, c);
-			outputs[INV_Y_OUTPUT].setVoltageSimd<float_4>(-y, c);
-			outputs[DIFF_OUTPUT].setVoltageSimd<float_4>(0.5 * (x - y), c);
-
-			// upsampled input arrays will be stored in these
-			float_4* xBuffer = oversampler[X_OUTPUT][c / 4].getOSBuffer();
-			float_4* yBuffer = oversampler[Y_OUTPUT][c / 4].getOSBuffer();
-			if (oversamplingRatio > 1) {
-				oversampler[X_OUTPUT][c / 4].upsample(x);
-				oversampler[Y_OUTPUT][c / 4].upsample(y);
+	// configures the groups' downsampling banks. Those that changed carry on from their outputs' current values rather
+	// than from silence, so the logic outputs don't click, the gates don't drop out and no spurious triggers are fired
+	template <typename T>
+	void configureOversamplers(Engine<T>& engine, const int* index, chowdsp::FilterQuality quality) {
+		for (int b = 0; b < Engine<T>::numBlocks; b++) {
+			const int c = b * T::size;
+			auto& oversamplers = engine.oversamplers[b];
+			if (configureOversampler(oversamplers.minMax, index[MIN_MAX_GROUP], quality)) {
+				oversamplers.minMax.settle(OR_SIGNAL, outputs[OR_OUTPUT].getVoltageSimd<T>(c));
+				oversamplers.minMax.settle(AND_SIGNAL, outputs[AND_OUTPUT].getVoltageSimd<T>(c));
 			}
-			else {
-				xBuffer[0] = x;
-				yBuffer[0] = y;
+			if (configureOversampler(oversamplers.exclusiveOr, index[XOR_GROUP], quality)) {
+				oversamplers.exclusiveOr.settle(0, outputs[XOR_OUTPUT].getVoltageSimd<T>(c));
 			}
-
-			// main logic outputs
-			float_4* orBuffer = oversampler[OR_OUTPUT][c / 4].getOSBuffer();
-			float_4* andBuffer = oversampler[AND_OUTPUT][c / 4].getOSBuffer();
-			float_4* xorBuffer = oversampler[XOR_OUTPUT][c / 4].getOSBuffer();
-			const int oversampleRatioMain = oversampleLogicOutputs ? oversamplingRatio : 1;
-			for (int i = 0; i < oversampleRatioMain; i++) {
-				const float_4 x_ = xBuffer[i];
-				const float_4 y_ = yBuffer[i];
-
-				orBuffer[i] = ifelse(x_ > y_, x_, y_);
-				andBuffer[i] = ifelse(x_ > y_, y_, x_);
-				const float_4 clip_x = ifelse(x_ > abs(y_), abs(y_), ifelse(x_ < -abs(y_), -abs(y_), x_));
-				xorBuffer[i] = ifelse(y_ > 0, -clip_x, clip_x);
-
-				if (clip10V) {
-					orBuffer[i] = clamp(orBuffer[i], -10.f, 10.f);
-					andBuffer[i] = clamp(andBuffer[i], -10.f, 10.f);
-					xorBuffer[i] = clamp(xorBuffer[i], -10.f, 10.f);
+			if (configureOversampler(oversamplers.gates, index[GATE_GROUP], quality)) {
+				for (int k = 0; k < NUM_LOGIC_SIGNALS; k++) {
+					oversamplers.gates.settle(k, outputs[gateOutputIds[k]].getVoltageSimd<T>(c));
 				}
 			}
-
-			// calculate logic outputs regardless if their outputs are used (LEDs still need to work, and easier to leave always on)
-			const float_4 analogueOr = oversampleLogicOutputs ? oversampler[OR_OUTPUT][c / 4].downsample() : orBuffer[0];
-			outputs[OR_OUTPUT].setVoltageSimd<float_4>(analogueOr, c);
-			const float_4 analogueNor = -analogueOr;
-			outputs[NOR_OUTPUT].setVoltageSimd<float_4>(analogueNor, c);
-
-			const float_4 analogueAnd = oversampleLogicOutputs ? oversampler[AND_OUTPUT][c / 4].downsample() : andBuffer[0];
-			outputs[AND_OUTPUT].setVoltageSimd<float_4>(analogueAnd, c);
-			const float_4 analogueNand = -analogueAnd;
-			outputs[NAND_OUTPUT].setVoltageSimd<float_4>(analogueNand, c);
-
-			const float_4 analogueXor = oversampleLogicOutputs ? oversampler[XOR_OUTPUT][c / 4].downsample() : xorBuffer[0];
-			outputs[XOR_OUTPUT].setVoltageSimd<float_4>(analogueXor, c);
-			const float_4 analogueXnor = -analogueXor;
-			outputs[XNOR_OUTPUT].setVoltageSimd<float_4>(analogueXnor, c);
-
-
-			// gate logic outputs
-			float_4* orGateBuffer = oversampler[OR_GATE_OUTPUT][c / 4].getOSBuffer();
-			float_4* andGateBuffer = oversampler[AND_GATE_OUTPUT][c / 4].getOSBuffer();
-			float_4* xorGateBuffer = oversampler[XOR_GATE_OUTPUT][c / 4].getOSBuffer();
-			const int oversampleRatioGates = oversampleLogicGateOutputs ? oversamplingRatio : 1;
-			for (int i = 0; i < oversampleRatioGates; i++) {
-				orGateBuffer[i] = ifelse(orBuffer[i] > threshold, 10.f, 0.f);
-				andGateBuffer[i] = ifelse(andBuffer[i] > threshold, 10.f, 0.f);
-				// xor gate is a little different, are x and y close to within a tolerance
-				xorGateBuffer[i] = ifelse(abs(xBuffer[i] - yBuffer[i]) > threshold, 10.f, 0.f);
+			if (configureOversampler(oversamplers.triggers, index[TRIGGER_GROUP], quality)) {
+				for (int k = 0; k < NUM_TRIGGER_SIGNALS; k++) {
+					oversamplers.triggers.settle(k, outputs[triggerOutputIds[k]].getVoltageSimd<T>(c));
+				}
 			}
+		}
+	}
 
-			// only bother with downsampling if there's an active output
-			if (outputs[OR_GATE_OUTPUT].isConnected() || outputs[NOR_GATE_OUTPUT].isConnected()) {
-				const float_4 orGateOut = oversampleLogicGateOutputs ? oversampler[OR_GATE_OUTPUT][c / 4].downsample() : orGateBuffer[0];
-				outputs[OR_GATE_OUTPUT].setVoltageSimd<float_4>(orGateOut, c);
-				const float_4 norGateOut = 10.f - orGateOut;
-				outputs[NOR_GATE_OUTPUT].setVoltageSimd<float_4>(norGateOut, c);
+	// X/Y are upsampled to the highest rate of the groups with a connected output, so this follows the groups' rates
+	// and the connections. The upsampling stages kept carry on, so the groups already running aren't disturbed
+	void configureUpsampling() {
+		int maxIndex = 0;
+		for (int g = 0; g < NUM_OVERSAMPLING_GROUPS; g++) {
+			if (dataflow.groupMask >> g & 1) {
+				maxIndex = std::max(maxIndex, getOversamplingIndex(g));
 			}
-			if (outputs[AND_GATE_OUTPUT].isConnected() || outputs[NAND_GATE_OUTPUT].isConnected()) {
-				const float_4 andGateOut = oversampleLogicGateOutputs ? oversampler[AND_GATE_OUTPUT][c / 4].downsample() : andGateBuffer[0];
-				outputs[AND_GATE_OUTPUT].setVoltageSimd<float_4>(andGateOut, c);
-				const float_4 nandGateOut = 10.f - andGateOut;
-				outputs[NAND_GATE_OUTPUT].setVoltageSimd<float_4>(nandGateOut, c);
-			}
-			if (outputs[XOR_GATE_OUTPUT].isConnected() || outputs[XNOR_GATE_OUTPUT].isConnected()) {
-				const float_4 xorGateOut = oversampleLogicGateOutputs ? oversampler[XOR_GATE_OUTPUT][c / 4].downsample() : xorGateBuffer[0];
-				outputs[XOR_GATE_OUTPUT].setVoltageSimd<float_4>(xorGateOut, c);
-				const float_4 xnorGateOut = 10.f - xorGateOut;
-				outputs[XNOR_GATE_OUTPUT].setVoltageSimd<float_4>(xnorGateOut, c);
+		}
+		const chowdsp::FilterQuality quality = engine4.oversamplers[0].minMax.getQuality();
+		configureUpsamplers(engine4, maxIndex, quality);
+#ifdef SIMD8_AVX2
+		if (engine8) {
+			configureUpsamplers(*engine8, maxIndex, quality);
+		}
+#endif
+	}
+
+	template <typename T>
+	void configureUpsamplers(Engine<T>& engine, int index, chowdsp::FilterQuality quality) {
+		for (auto& oversamplers : engine.oversamplers) {
+			if (oversamplers.xy.getQuality() != quality) {
+				// which clears the upsampler, so it carries on from the latest X/Y instead
+				const T xy[2] = {*oversamplers.xy.getOSBuffer(0, 0), *oversamplers.xy.getOSBuffer(1, 0)};
+				oversamplers.xy.setQuality(quality);
+				for (int k = 0; k < 2; k++) {
+					oversamplers.xy.settle(k, xy[k]);
+				}
 			}
+			oversamplers.xy.setOversamplingIndex(index);
+		}
+	}
 
+	// sets a bank's factor and quality, returning whether either changed
+	template <typename Bank>
+	static bool configureOversampler(Bank& bank, int index, chowdsp::FilterQuality quality) {
+		const int oldIndex = bank.getOversamplingIndex();
+		const chowdsp::FilterQuality oldQuality = bank.getQuality();
+		bank.setQuality(quality);
+		bank.setOversamplingIndex(index);
+		return bank.getOversamplingIndex() != oldIndex || bank.getQuality() != oldQuality;
+	}
 
-			// trigger outputs (derived from gates)
-			float_4* orTriggerBuffer = oversampler[OR_TRIG_OUTPUT][c / 4].getOSBuffer();
-			float_4* norTriggerBuffer = oversampler[NOR_TRIG_OUTPUT][c / 4].getOSBuffer();
-			float_4* andTriggerBuffer = oversampler[AND_TRIG_OUTPUT][c / 4].getOSBuffer();
-			float_4* nandTriggerBuffer = oversampler[NAND_TRIG_OUTPUT][c / 4].getOSBuffer();
-			float_4* xorTriggerBuffer = oversampler[XOR_TRIG_OUTPUT][c / 4].getOSBuffer();
-			float_4* xnorTriggerBuffer = oversampler[XNOR_TRIG_OUTPUT][c / 4].getOSBuffer();
-			const int oversampleRatioTriggers = oversampleLogicTriggerOutputs ? oversamplingRatio : 1;
-			const float deltaTime = args.sampleTime / oversampleRatioTriggers;
-
-			for (int i = 0; i < oversampleRatioTriggers; i++) {
-
-				const float_4 orTriggerHigh = logicalOrGate[c].process(orGateBuffer[i]);
-				logicalOrPulseGenerator[c].trigger(orTriggerHigh, 1e-3);
-				orTriggerBuffer[i] = ifelse(logicalOrPulseGenerator[c].process(deltaTime), 10.f, 0.f);
-				// gate is literal inverse
-				const float_4 norTiggerHigh = logicalNorGate[c].process(10.f - orGateBuffer[i]);
-				logicalNorPulseGenerator[c].trigger(norTiggerHigh, 1e-3);
-				norTriggerBuffer[i] = ifelse(logicalNorPulseGenerator[c].process(deltaTime), 10.f, 0.f);
-
-				const float_4 andTriggerHigh = logicalAndGate[c].process(andGateBuffer[i]);
-				logicalAndPulseGenerator[c].trigger(andTriggerHigh, 1e-3);
-				andTriggerBuffer[i] = ifelse(logicalAndPulseGenerator[c].process(deltaTime), 10.f, 0.f);
-				// gate is literal inverse
-				const float_4 nandTriggerHigh = logicalNandGate[c].process(10.f - andGateBuffer[i]);
-				logicalNandPulseGenerator[c].trigger(nandTriggerHigh, 1e-3);
-				nandTriggerBuffer[i] = ifelse(logicalNandPulseGenerator[c].process(deltaTime), 10.f, 0.f);
-
-				const float_4 xorTriggerHigh = logicalXorGate[c].process(xorGateBuffer[i]);
-				logicalXorPulseGenerator[c].trigger(xorTriggerHigh, 1e-3);
-				xorTriggerBuffer[i] = ifelse(logicalXorPulseGenerator[c].process(deltaTime), 10.f, 0.f);
-				// gate is literal inverse
-				const float_4 xnorTriggerHigh = logicalXnorGate[c].process(10.f - xorGateBuffer[i]);
-				logicalXnorPulseGenerator[c].trigger(xnorTriggerHigh, 1e-3);
-				xnorTriggerBuffer[i] = ifelse(logicalXnorPulseGenerator[c].process(deltaTime), 10.f, 0.f);
-			}
+	// the (clamped) index actually in use by a group
+	int getOversamplingIndex(int group) const {
+		const auto& oversamplers = engine4.oversamplers[0];
+		switch (group) {
+			case MIN_MAX_GROUP: return oversamplers.minMax.getOversamplingIndex();
+			case XOR_GROUP: return oversamplers.exclusiveOr.getOversamplingIndex();
+			case GATE_GROUP: return oversamplers.gates.getOversamplingIndex();
+			case TRIGGER_GROUP: return oversamplers.triggers.getOversamplingIndex();
+			default: return 0;
+		}
+	}
 
-			// updates trigger outputs (if they are connected)
-			updateTriggerOutput(OR_TRIG_OUTPUT, c, orTriggerBuffer);
-			updateTriggerOutput(NOR_TRIG_OUTPUT, c, norTriggerBuffer);
-			updateTriggerOutput(AND_TRIG_OUTPUT, c, andTriggerBuffer);
-			updateTriggerOutput(NAND_TRIG_OUTPUT, c, nandTriggerBuffer);
-			updateTriggerOutput(XOR_TRIG_OUTPUT, c, xorTriggerBuffer);
-			updateTriggerOutput(XNOR_TRIG_OUTPUT, c, xnorTriggerBuffer);
+	void process(const ProcessArgs& args) override {
 
-		}	 // end of polyphony loop
+		// oversampling changes from the menu are made between frames, crossfading the oversampled logic outputs
+		GroupOversamplingSettings newSettings;
+		if (oversamplingSwitch.process(newSettings, dataflow.logicMode == LOGIC_OVERSAMPLED, args.sampleTime)) {
+			applyOversampling(newSettings, args.sampleRate);
+		}
+
+		const int numActivePolyphonyChannels = std::max({1, inputs[X_INPUT].getChannels(), inputs[Y_INPUT].getChannels()});
+		xButtonTrigger.process(params[PAD_X_PARAM].getValue());
+		yButtonTrigger.process(params[PAD_Y_PARAM].getValue());
+
+		const float xPressure = pressure[PAD_X_PARAM].process(args.frame, args.sampleRate);
+		const float yPressure = pressure[PAD_Y_PARAM].process(args.frame, args.sampleRate);
+		const float xPad = params[PRESSURE_PARAM].getValue() * xPressure * xButtonTrigger.isHigh();
+		const float yPad = params[PRESSURE_PARAM].getValue() * yPressure * yButtonTrigger.isHigh();
+
+		updateDataflow();
+
+		Frame frame;
+		frame.numChannels = numActivePolyphonyChannels;
+		frame.xPad = xPad;
+		frame.yPad = yPad;
+		frame.threshold = params[THRESHOLD_PARAM].getValue();
+		frame.clipLimit = clip10V ? 10.f : INFINITY;
+		for (int g = 0; g < NUM_OVERSAMPLING_GROUPS; g++) {
+			frame.level[g] = (dataflow.groupMask >> g & 1) ? getOversamplingIndex(g) : 0;
+		}
+		frame.oversampledGain = oversamplingSwitch.gain;
+		directDelay += clamp(getDirectDelay() - directDelay, -directDelaySlew, directDelaySlew);
+		frame.directDelay = directDelay;
+		frame.sampleTime = args.sampleTime;
+		frame.wake = wakeBlocks || !frame.sameSettings(lastFrame);
+		lastFrame = frame;
+		wakeBlocks = false;
+
+#ifdef SIMD8_AVX2
+		const bool useEngine8 = engine8 && numActivePolyphonyChannels > 4;
+		if (useEngine8 != engine8Active) {
+			if (useEngine8) {
+				engine8->takeOver(engine4);
+			}
+			else {
+				engine4.takeOver(*engine8);
+			}
+			engine8Active = useEngine8;
+		}
+		if (useEngine8) {
+			(this->*kernel8)(frame);
+		}
+		else
+#endif
+		{
+			(this->*kernel4)(frame);
+		}
 
 		if (numActivePolyphonyChannels == 1) {
 			setRedGreenLED(OR_LIGHT, outputs[OR_OUTPUT].getVoltage(), args.sampleTime);
@@ -344,12 +552,375 @@ struct Cosmos : Module {
 		}
 	}
 
-	// if the output is connected, downsample (if appropriate) and set the voltage
-	void updateTriggerOutput(int outputId, int channel, float_4* buffer) {
-		if (outputs[outputId].isConnected()) {
-			// only oversample if needed
-			const float_4 triggerOut = oversampleLogicTriggerOutputs ? oversampler[outputId][channel / 4].downsample() : buffer[0];
-			outputs[outputId].setVoltageSimd<float_4>(triggerOut, channel);
+
+	// group delay of the logic outputs, in samples (the slower of the two logic groups, if they differ)
+	float getLogicLatency() const {
+		if (adaaLogicOutputs) {
+			return 1.f; // see cosmos::LogicADAA
+		}
+		return std::max(oversamplingLatency[MIN_MAX_GROUP], oversamplingLatency[XOR_GROUP]);
+	}
+
+	// delay of the direct outputs, to match the connected logic outputs (none if there aren't any)
+	float getDirectDelay() const {
+		const int logicGroups = dataflow.groupMask & (1 << MIN_MAX_GROUP | 1 << XOR_GROUP);
+		if (!alignDirectOutputs || !logicGroups) {
+			return 0.f;
+		}
+		if (adaaLogicOutputs) {
+			return getLogicLatency();
+		}
+		float latency = 0.f;
+		for (int g : {MIN_MAX_GROUP, XOR_GROUP}) {
+			if (logicGroups >> g & 1) {
+				latency = std::max(latency, oversamplingLatency[g]);
+			}
+		}
+		return latency;
+	}
+
+	// rebuilds the dataflow, and selects the kernels for it, if any output has been (dis)connected or the oversampling settings changed
+	void updateDataflow() {
+		uint32_t key = 0;
+		for (int outputId = 0; outputId < OUTPUTS_LEN; outputId++) {
+			key |= (uint32_t) outputs[outputId].isConnected() << outputId;
+		}
+		key |= (uint32_t) adaaLogicOutputs << OUTPUTS_LEN;
+		key |= (uint32_t) polyBlepGateOutputs << (OUTPUTS_LEN + 1);
+		for (int g = 0; g < NUM_OVERSAMPLING_GROUPS; g++) {
+			key |= (uint32_t)(getOversamplingIndex(g) > 0) << (OUTPUTS_LEN + 2 + g);
+		}
+		if (key == dataflowKey) {
+			return;
+		}
+		dataflowKey = key;
+		wakeBlocks = true;
+
+		auto connected = [&](OutputId a, OutputId b) {
+			return outputs[a].isConnected() || outputs[b].isConnected();
+		};
+		Dataflow d;
+		d.logicMask = connected(OR_OUTPUT, NOR_OUTPUT) << OR_SIGNAL
+		              | connected(AND_OUTPUT, NAND_OUTPUT) << AND_SIGNAL
+		              | connected(XOR_OUTPUT, XNOR_OUTPUT) << XOR_SIGNAL;
+		d.gateOutputMask = connected(OR_GATE_OUTPUT, NOR_GATE_OUTPUT) << OR_SIGNAL
+		                   | connected(AND_GATE_OUTPUT, NAND_GATE_OUTPUT) << AND_SIGNAL
+		                   | connected(XOR_GATE_OUTPUT, XNOR_GATE_OUTPUT) << XOR_SIGNAL;
+		for (int k = 0; k < NUM_TRIGGER_SIGNALS; k++) {
+			if (outputs[triggerOutputIds[k]].isConnected()) {
+				d.triggerMask |= 1 << k;
+			}
+		}
+		d.gateMask = d.gateOutputMask
+		             | connected(OR_TRIG_OUTPUT, NOR_TRIG_OUTPUT) << OR_SIGNAL
+		             | connected(AND_TRIG_OUTPUT, NAND_TRIG_OUTPUT) << AND_SIGNAL
+		             | connected(XOR_TRIG_OUTPUT, XNOR_TRIG_OUTPUT) << XOR_SIGNAL;
+		d.groupMask = (d.logicMask & minMaxSignals ? 1 : 0) << MIN_MAX_GROUP
+		              | (d.logicMask >> XOR_SIGNAL & 1) << XOR_GROUP
+		              | (d.gateOutputMask ? 1 : 0) << GATE_GROUP
+		              | (d.triggerMask ? 1 : 0) << TRIGGER_GROUP;
+		// groups with something connected that are oversampled, each independently of the others
+		int oversampledGroups = 0;
+		for (int g = 0; g < NUM_OVERSAMPLING_GROUPS; g++) {
+			oversampledGroups |= (getOversamplingIndex(g) > 0) << g;
+		}
+		oversampledGroups &= d.groupMask;
+
+		// the ADAA logic outputs are always run, as they feed the LEDs
+		if (adaaLogicOutputs) {
+			d.logicMode = LOGIC_ADAA;
+		}
+		else if (oversampledGroups & (1 << MIN_MAX_GROUP | 1 << XOR_GROUP)) {
+			d.logicMode = LOGIC_OVERSAMPLED;
+		}
+		if (!d.gateMask) {
+			d.gateMode = GATES_OFF;
+		}
+		else if (polyBlepGateOutputs) {
+			d.gateMode = GATES_POLYBLEP;
+		}
+		else if (oversampledGroups & (1 << GATE_GROUP | 1 << TRIGGER_GROUP)) {
+			d.gateMode = GATES_OVERSAMPLED;
+		}
+		else {
+			d.gateMode = GATES_BASE_RATE;
+		}
+		d.triggers = d.triggerMask && !polyBlepGateOutputs;
+		dataflow = d;
+		configureUpsampling();
+
+		// triggers always have gates to derive them from, and polyBLEP ones are made with the gates
+		assert(!d.triggers || d.gateMode == GATES_BASE_RATE || d.gateMode == GATES_OVERSAMPLED);
+		const int gateKernel = !d.triggers ? d.gateMode : (d.gateMode == GATES_BASE_RATE) ? NUM_GATE_MODES : NUM_GATE_MODES + 1;
+		const int kernelIndex = d.logicMode * NUM_GATE_KERNELS + gateKernel;
+		static const auto kernels4 = makeKernels4(std::make_index_sequence<NUM_LOGIC_MODES * NUM_GATE_KERNELS>());
+		kernel4 = kernels4[kernelIndex];
+#ifdef SIMD8_AVX2
+		static const auto kernels8 = makeKernels8(std::make_index_sequence<NUM_LOGIC_MODES * NUM_GATE_KERNELS>());
+		kernel8 = kernels8[kernelIndex];
+#endif
+	}
+
+	// the combinations of gate mode and triggers that the dataflow can reach: each gate mode without triggers, then
+	// base rate and oversampled gates with them
+	enum {
+		NUM_GATE_KERNELS = NUM_GATE_MODES + 2
+	};
+	static constexpr GateMode kernelGateMode(size_t i) {
+		return i < NUM_GATE_MODES ? (GateMode) i : (i == NUM_GATE_MODES) ? GATES_BASE_RATE : GATES_OVERSAMPLED;
+	}
+
+	// tables of the kernels for the reachable combinations of modes, indexed by logicMode * NUM_GATE_KERNELS + gate kernel
+	template <size_t... I>
+	static std::array<Kernel, sizeof...(I)> makeKernels4(std::index_sequence<I...>) {
+		return {{&Cosmos::processKernel4<(LogicMode)(I / NUM_GATE_KERNELS), kernelGateMode(I % NUM_GATE_KERNELS), (I % NUM_GATE_KERNELS >= NUM_GATE_MODES)>...}};
+	}
+#ifdef SIMD8_AVX2
+	template <size_t... I>
+	static std::array<Kernel, sizeof...(I)> makeKernels8(std::index_sequence<I...>) {
+		return {{&Cosmos::processKernelAVX2<(LogicMode)(I / NUM_GATE_KERNELS), kernelGateMode(I % NUM_GATE_KERNELS), (I % NUM_GATE_KERNELS >= NUM_GATE_MODES)>...}};
+	}
+#endif
+
+	template <LogicMode logicMode, GateMode gateMode, bool triggers>
+	void processKernel4(const Frame& frame) {
+		processChannels<float_4, logicMode, gateMode, triggers>(engine4, frame);
+	}
+
+#ifdef SIMD8_AVX2
+	// the float_8 kernels compiled for AVX2, only called if the CPU supports it
+	template <LogicMode logicMode, GateMode gateMode, bool triggers>
+	SIMD8_AVX2_TARGET
+	void processKernelAVX2(const Frame& frame) {
+		processChannels<float_8, logicMode, gateMode, triggers>(*engine8, frame);
+	}
+#endif
+
+	// processes all active channels (in blocks of T::size), other than the LEDs. The modes are fixed at compile time, so
+	// the only run time choices left are the channel count and each group's oversampling ratio (which the oversamplers
+	// dispatch on). A group at ratio 1 reads the base rate level of the upsampled X/Y, and its bank just copies
+	template <typename T, LogicMode logicMode, GateMode gateMode, bool triggers>
+	void processChannels(Engine<T>& engine, const Frame& frame) {
+		// X/Y are upsampled, to the highest group rate, if any oversampled stage depends on them
+		constexpr bool upsample = logicMode == LOGIC_OVERSAMPLED || gateMode == GATES_OVERSAMPLED;
+
+		const float clipLimit = frame.clipLimit;
+		const float threshold = frame.threshold;
+
+		// loop over polyphony channels in blocks of T::size
+		for (int c = 0; c < frame.numChannels; c += T::size) {
+			const int b = c / T::size;
+			// x, y are normalled to the pad inputs
+			const T x = inputs[X_INPUT].getNormalPolyVoltageSimd<T>(T(frame.xPad), c);
+			const T y = inputs[Y_INPUT].getNormalPolyVoltageSimd<T>(T(frame.yPad), c);
+			const T xy[2] = {x, y};
+
+			// idle blocks (e.g. released voices) keep the outputs they have, all of which have settled
+			if (frame.wake) {
+				engine.activity[b].wake();
+			}
+			if (!engine.activity[b].process(xy)) {
+				continue;
+			}
+
+			// basic main outputs (delayed, if aligning them with the oversampled outputs)
+			const T xDirect = engine.xDelay[b].process(x, frame.directDelay);
+			const T yDirect = engine.yDelay[b].process(y, frame.directDelay);
+			outputs[X_OUTPUT].setVoltageSimd<T>(xDirect, c);
+			outputs[Y_OUTPUT].setVoltageSimd<T>(yDirect, c);
+			outputs[SUM_OUTPUT].setVoltageSimd<T>(0.5 * (xDirect + yDirect), c);
+			// basic inverse outputs
+			outputs[INV_X_OUTPUT].setVoltageSimd<T>(-xDirect, c);
+			outputs[INV_Y_OUTPUT].setVoltageSimd<T>(-yDirect, c);
+			outputs[DIFF_OUTPUT].setVoltageSimd<T>(0.5 * (xDirect - yDirect), c);
+
+			// logic at the base rate, for the LEDs and any stage that isn't oversampled
+			const T logic1x[NUM_LOGIC_SIGNALS] = {
+				clamp(cosmos::logicOr(x, y), -clipLimit, clipLimit),
+				clamp(cosmos::logicAnd(x, y), -clipLimit, clipLimit),
+				clamp(cosmos::logicXor(x, y), -clipLimit, clipLimit)
+			};
+
+			auto& oversamplers = engine.oversamplers[b];
+			if constexpr (upsample) {
+				oversamplers.xy.upsample(xy);
+			}
+
+			// the logic outputs are always written (the LEDs read them), but disconnected ones use the base rate values
+			T logicOut[NUM_LOGIC_SIGNALS] = {logic1x[OR_SIGNAL], logic1x[AND_SIGNAL], logic1x[XOR_SIGNAL]};
+			if constexpr (logicMode == LOGIC_ADAA) {
+				engine.logicADAA[b].process(x, y, logicOut[OR_SIGNAL], logicOut[AND_SIGNAL], logicOut[XOR_SIGNAL]);
+				for (int k = 0; k < NUM_LOGIC_SIGNALS; k++) {
+					logicOut[k] = clamp(logicOut[k], -clipLimit, clipLimit);
+				}
+			}
+			else if constexpr (logicMode == LOGIC_OVERSAMPLED) {
+				// OR and AND at their group's rate
+				{
+					const int level = frame.level[MIN_MAX_GROUP];
+					const T* xBuffer = oversamplers.xy.getOSBuffer(0, level);
+					const T* yBuffer = oversamplers.xy.getOSBuffer(1, level);
+					T* orBuffer = oversamplers.minMax.getOSBuffer(OR_SIGNAL);
+					T* andBuffer = oversamplers.minMax.getOSBuffer(AND_SIGNAL);
+					for (int i = 0; i < (1 << level); i++) {
+						orBuffer[i] = clamp(cosmos::logicOr(xBuffer[i], yBuffer[i]), -clipLimit, clipLimit);
+						andBuffer[i] = clamp(cosmos::logicAnd(xBuffer[i], yBuffer[i]), -clipLimit, clipLimit);
+					}
+					oversamplers.minMax.downsample(logicOut, dataflow.logicMask & minMaxSignals);
+				}
+				// XOR at its own
+				{
+					const int level = frame.level[XOR_GROUP];
+					const T* xBuffer = oversamplers.xy.getOSBuffer(0, level);
+					const T* yBuffer = oversamplers.xy.getOSBuffer(1, level);
+					T* xorBuffer = oversamplers.exclusiveOr.getOSBuffer(0);
+					for (int i = 0; i < (1 << level); i++) {
+						xorBuffer[i] = clamp(cosmos::logicXor(xBuffer[i], yBuffer[i]), -clipLimit, clipLimit);
+					}
+					oversamplers.exclusiveOr.downsample(&logicOut[XOR_SIGNAL], dataflow.logicMask >> XOR_SIGNAL & 1);
+				}
+				for (int k = 0; k < NUM_LOGIC_SIGNALS; k++) {
+					logicOut[k] = logic1x[k] + frame.oversampledGain * (logicOut[k] - logic1x[k]);
+				}
+			}
+
+			const T analogueOr = logicOut[OR_SIGNAL];
+			outputs[OR_OUTPUT].setVoltageSimd<T>(analogueOr, c);
+			const T analogueNor = -analogueOr;
+			outputs[NOR_OUTPUT].setVoltageSimd<T>(analogueNor, c);
+
+			const T analogueAnd = logicOut[AND_SIGNAL];
+			outputs[AND_OUTPUT].setVoltageSimd<T>(analogueAnd, c);
+			const T analogueNand = -analogueAnd;
+			outputs[NAND_OUTPUT].setVoltageSimd<T>(analogueNand, c);
+
+			const T analogueXor = logicOut[XOR_SIGNAL];
+			outputs[XOR_OUTPUT].setVoltageSimd<T>(analogueXor, c);
+			const T analogueXnor = -analogueXor;
+			outputs[XNOR_OUTPUT].setVoltageSimd<T>(analogueXnor, c);
+
+			// nothing below is patched
+			if constexpr (gateMode == GATES_OFF) {
+				continue;
+			}
+			else if constexpr (gateMode == GATES_POLYBLEP) {
+				processPolyBlepGates(engine, b, c, x, y, logic1x, threshold, frame.sampleTime);
+				continue;
+			}
+
+			// gate logic outputs (gates only needed by the triggers are left to them, and their outputs written as 0V)
+			T gateOut[NUM_LOGIC_SIGNALS] = {};
+			if constexpr (gateMode == GATES_OVERSAMPLED) {
+				const int level = frame.level[GATE_GROUP];
+				const T* xBuffer = oversamplers.xy.getOSBuffer(0, level);
+				const T* yBuffer = oversamplers.xy.getOSBuffer(1, level);
+				T* gateBuffers[NUM_LOGIC_SIGNALS];
+				for (int k = 0; k < NUM_LOGIC_SIGNALS; k++) {
+					gateBuffers[k] = oversamplers.gates.getOSBuffer(k);
+				}
+				for (int i = 0; i < (1 << level); i++) {
+					computeGates(xBuffer[i], yBuffer[i], threshold, gateBuffers, i);
+				}
+				oversamplers.gates.downsample(gateOut, dataflow.gateOutputMask);
+			}
+			else {
+				T* gateBuffers[NUM_LOGIC_SIGNALS] = {&gateOut[OR_SIGNAL], &gateOut[AND_SIGNAL], &gateOut[XOR_SIGNAL]};
+				computeGates(x, y, threshold, gateBuffers, 0);
+			}
+
+			const T orGateOut = gateOut[OR_SIGNAL];
+			outputs[OR_GATE_OUTPUT].setVoltageSimd<T>(orGateOut, c);
+			const T norGateOut = 10.f - orGateOut;
+			outputs[NOR_GATE_OUTPUT].setVoltageSimd<T>(norGateOut, c);
+
+			const T andGateOut = gateOut[AND_SIGNAL];
+			outputs[AND_GATE_OUTPUT].setVoltageSimd<T>(andGateOut, c);
+			const T nandGateOut = 10.f - andGateOut;
+			outputs[NAND_GATE_OUTPUT].setVoltageSimd<T>(nandGateOut, c);
+
+			const T xorGateOut = gateOut[XOR_SIGNAL];
+			outputs[XOR_GATE_OUTPUT].setVoltageSimd<T>(xorGateOut, c);
+			const T xnorGateOut = 10.f - xorGateOut;
+			outputs[XNOR_GATE_OUTPUT].setVoltageSimd<T>(xnorGateOut, c);
+
+			if constexpr (triggers) {
+				// trigger outputs, from gates of their own at the trigger group's rate, all six updated together
+				int level = 0;
+				const T* xBuffer = &x;
+				const T* yBuffer = &y;
+				if constexpr (gateMode == GATES_OVERSAMPLED) {
+					level = frame.level[TRIGGER_GROUP];
+					xBuffer = oversamplers.xy.getOSBuffer(0, level);
+					yBuffer = oversamplers.xy.getOSBuffer(1, level);
+				}
+				T* triggerBuffers[NUM_TRIGGER_SIGNALS];
+				for (int k = 0; k < NUM_TRIGGER_SIGNALS; k++) {
+					triggerBuffers[k] = oversamplers.triggers.getOSBuffer(k);
+				}
+				const float deltaTime = frame.sampleTime / (1 << level);
+
+				for (int i = 0; i < (1 << level); i++) {
+					T gates[NUM_LOGIC_SIGNALS];
+					T* gateBuffers[NUM_LOGIC_SIGNALS] = {&gates[OR_SIGNAL], &gates[AND_SIGNAL], &gates[XOR_SIGNAL]};
+					computeGates(xBuffer[i], yBuffer[i], threshold, gateBuffers, 0);
+					// the inverted triggers' gates are literal inverses
+					const T triggerGates[NUM_TRIGGER_SIGNALS] = {
+						gates[OR_SIGNAL], 10.f - gates[OR_SIGNAL],
+						gates[AND_SIGNAL], 10.f - gates[AND_SIGNAL],
+						gates[XOR_SIGNAL], 10.f - gates[XOR_SIGNAL]
+					};
+					T pulses[NUM_TRIGGER_SIGNALS];
+					engine.triggerBank[b].process(triggerGates, pulses, deltaTime);
+					for (int k = 0; k < NUM_TRIGGER_SIGNALS; k++) {
+						triggerBuffers[k][i] = pulses[k];
+					}
+				}
+
+				T triggerOut[NUM_TRIGGER_SIGNALS] = {};
+				if constexpr (gateMode == GATES_OVERSAMPLED) {
+					oversamplers.triggers.downsample(triggerOut, dataflow.triggerMask);
+				}
+				else {
+					for (int k = 0; k < NUM_TRIGGER_SIGNALS; k++) {
+						triggerOut[k] = triggerBuffers[k][0];
+					}
+				}
+				for (int k = 0; k < NUM_TRIGGER_SIGNALS; k++) {
+					outputs[triggerOutputIds[k]].setVoltageSimd<T>(triggerOut[k], c);
+				}
+			}
+
+		}	 // end of polyphony loop
+	}
+
+	// the OR, AND and XOR gates of one (possibly oversampled) sample of X/Y, written to gateBuffers[k][i]. The gates only
+	// compare against the threshold (at most 2V), so the logic needn't be clipped first
+	template <typename T>
+	static void computeGates(T x, T y, float threshold, T* const* gateBuffers, int i) {
+		gateBuffers[OR_SIGNAL][i] = ifelse(cosmos::logicOr(x, y) > threshold, 10.f, 0.f);
+		gateBuffers[AND_SIGNAL][i] = ifelse(cosmos::logicAnd(x, y) > threshold, 10.f, 0.f);
+		// xor gate is a little different, are x and y close to within a tolerance
+		gateBuffers[XOR_SIGNAL][i] = ifelse(abs(x - y) > threshold, 10.f, 0.f);
+	}
+
+	// gates and triggers of one block of channels at the base rate, with polyBLEP corrected edges (one sample late).
+	// All are run, as they are cheap and without the masks' branches the compiler keeps the three gates in registers
+	template <typename T>
+	void processPolyBlepGates(Engine<T>& engine, int b, int c, T x, T y, const T* logic1x, float threshold, float sampleTime) {
+		const T gateInputs[NUM_LOGIC_SIGNALS] = {logic1x[OR_SIGNAL], logic1x[AND_SIGNAL], abs(x - y)};
+
+		for (int k = 0; k < NUM_LOGIC_SIGNALS; k++) {
+			TPolyBlepGate<T>& gate = engine.polyBlepGate[k][b];
+			const T gateOut = gate.process(gateInputs[k], threshold);
+			outputs[gateOutputIds[k]].setVoltageSimd<T>(gateOut, c);
+			outputs[invertedGateOutputIds[k]].setVoltageSimd<T>(10.f - gateOut, c);
+
+			// triggers come in pairs (OR, NOR etc.), from the rising and falling edges of the gate
+			for (int edge = 0; edge < 2; edge++) {
+				const int trigger = 2 * k + edge;
+				const T triggerOut = engine.polyBlepTrigger[trigger][b].process(edge ? gate.falling : gate.rising, gate.alpha, sampleTime);
+				outputs[triggerOutputIds[trigger]].setVoltageSimd<T>(triggerOut, c);
+			}
 		}
 	}
 
@@ -367,30 +938,50 @@ struct Cosmos : Module {
 
 	json_t* dataToJson() override {
 		json_t* rootJ = json_object();
-		json_object_set_new(rootJ, "oversampleLogicOutputs", json_boolean(oversampleLogicOutputs));
-		json_object_set_new(rootJ, "oversampleLogicGateOutputs", json_boolean(oversampleLogicGateOutputs));
-		json_object_set_new(rootJ, "oversampleLogicTriggerOutputs", json_boolean(oversampleLogicTriggerOutputs));
+		json_object_set_new(rootJ, "adaaLogicOutputs", json_boolean(adaaLogicOutputs));
+		json_object_set_new(rootJ, "polyBlepGateOutputs", json_boolean(polyBlepGateOutputs));
+		json_object_set_new(rootJ, "alignDirectOutputs", json_boolean(alignDirectOutputs));
 		json_object_set_new(rootJ, "clip10V", json_boolean(clip10V));
-		json_object_set_new(rootJ, "oversamplingIndex", json_integer(oversampler[0][0].getOversamplingIndex()));
+		json_t* groupOversamplingIndexJ = json_array();
+		json_t* groupAutoOversamplingJ = json_array();
+		for (int g = 0; g < NUM_OVERSAMPLING_GROUPS; g++) {
+			json_array_append_new(groupOversamplingIndexJ, json_integer(oversamplingIndex[g]));
+			json_array_append_new(groupAutoOversamplingJ, json_boolean(autoOversampling[g]));
+		}
+		json_object_set_new(rootJ, "groupOversamplingIndex", groupOversamplingIndexJ);
+		json_object_set_new(rootJ, "groupAutoOversampling", groupAutoOversamplingJ);
+		json_object_set_new(rootJ, "oversamplingQuality", json_integer(oversamplingQuality));
+
+		// for older versions (before the per-group rates), the highest group rate and the groups that are oversampled
+		int groupIndex[NUM_OVERSAMPLING_GROUPS];
+		for (int g = 0; g < NUM_OVERSAMPLING_GROUPS; g++) {
+			groupIndex[g] = autoOversampling[g]
+			                ? chowdsp::getOversamplingIndexForRate(APP->engine->getSampleRate(), autoOversamplingRate)
+			                : oversamplingIndex[g];
+		}
+		json_object_set_new(rootJ, "oversamplingIndex", json_integer(*std::max_element(groupIndex, groupIndex + NUM_OVERSAMPLING_GROUPS)));
+		json_object_set_new(rootJ, "oversampleLogicOutputs", json_boolean(groupIndex[MIN_MAX_GROUP] > 0 || groupIndex[XOR_GROUP] > 0));
+		json_object_set_new(rootJ, "oversampleLogicGateOutputs", json_boolean(groupIndex[GATE_GROUP] > 0));
+		json_object_set_new(rootJ, "oversampleLogicTriggerOutputs", json_boolean(groupIndex[TRIGGER_GROUP] > 0));
 
 		return rootJ;
 	}
 
 	void dataFromJson(json_t* rootJ) override {
 
-		json_t* oversampleLogicOutputsJ = json_object_get(rootJ, "oversampleLogicOutputs");
-		if (oversampleLogicOutputsJ) {
-			oversampleLogicOutputs = json_boolean_value(oversampleLogicOutputsJ);
+		json_t* adaaLogicOutputsJ = json_object_get(rootJ, "adaaLogicOutputs");
+		if (adaaLogicOutputsJ) {
+			adaaLogicOutputs = json_boolean_value(adaaLogicOutputsJ);
 		}
 
-		json_t* oversampleLogicGateOutputsJ = json_object_get(rootJ, "oversampleLogicGateOutputs");
-		if (oversampleLogicGateOutputsJ) {
-			oversampleLogicGateOutputs = json_boolean_value(oversampleLogicGateOutputsJ);
+		json_t* polyBlepGateOutputsJ = json_object_get(rootJ, "polyBlepGateOutputs");
+		if (polyBlepGateOutputsJ) {
+			polyBlepGateOutputs = json_boolean_value(polyBlepGateOutputsJ);
 		}
 
-		json_t* oversampleLogicTriggerOutputsJ = json_object_get(rootJ, "oversampleLogicTriggerOutputs");
-		if (oversampleLogicTriggerOutputsJ) {
-			oversampleLogicTriggerOutputs = json_boolean_value(oversampleLogicTriggerOutputsJ);
+		json_t* alignDirectOutputsJ = json_object_get(rootJ, "alignDirectOutputs");
+		if (alignDirectOutputsJ) {
+			alignDirectOutputs = json_boolean_value(alignDirectOutputsJ);
 		}
 
 		json_t* clip10VJ = json_object_get(rootJ, "clip10V");
@@ -398,10 +989,69 @@ struct Cosmos : Module {
 			clip10V = json_boolean_value(clip10VJ);
 		}
 
+		json_t* oversamplingQualityJ = json_object_get(rootJ, "oversamplingQuality");
+		if (oversamplingQualityJ) {
+			oversamplingQuality = clamp((int) json_integer_value(oversamplingQualityJ), 0, chowdsp::NUM_QUALITIES - 1);
+		}
+
+		json_t* groupOversamplingIndexJ = json_object_get(rootJ, "groupOversamplingIndex");
+		json_t* groupAutoOversamplingJ = json_object_get(rootJ, "groupAutoOversampling");
+		if (groupOversamplingIndexJ) {
+			for (int g = 0; g < NUM_OVERSAMPLING_GROUPS; g++) {
+				json_t* indexJ = json_array_get(groupOversamplingIndexJ, g);
+				if (indexJ) {
+					oversamplingIndex[g] = json_integer_value(indexJ);
+				}
+				json_t* autoJ = groupAutoOversamplingJ ? json_array_get(groupAutoOversamplingJ, g) : NULL;
+				if (autoJ) {
+					autoOversampling[g] = json_boolean_value(autoJ);
+				}
+			}
+		}
+		else {
+			dataFromLegacyJson(rootJ);
+		}
+		onSampleRateChange();
+	}
+
+	// patches from before the per-group rates have one rate, and flags for the groups that use it (trigger oversampling
+	// implied gate oversampling, which implied logic oversampling), so those groups get the rate and the others are off
+	void dataFromLegacyJson(json_t* rootJ) {
+		int index = 2;
 		json_t* oversamplingIndexJ = json_object_get(rootJ, "oversamplingIndex");
 		if (oversamplingIndexJ) {
-			oversamplingIndex = json_integer_value(oversamplingIndexJ);
-			onSampleRateChange();
+			index = json_integer_value(oversamplingIndexJ);
+		}
+
+		bool autoRate = false;
+		json_t* autoOversamplingJ = json_object_get(rootJ, "autoOversampling");
+		if (autoOversamplingJ) {
+			autoRate = json_boolean_value(autoOversamplingJ);
+		}
+
+		bool oversampleTriggers = false;
+		json_t* oversampleLogicTriggerOutputsJ = json_object_get(rootJ, "oversampleLogicTriggerOutputs");
+		if (oversampleLogicTriggerOutputsJ) {
+			oversampleTriggers = json_boolean_value(oversampleLogicTriggerOutputsJ);
+		}
+
+		bool oversampleGates = oversampleTriggers;
+		json_t* oversampleLogicGateOutputsJ = json_object_get(rootJ, "oversampleLogicGateOutputs");
+		if (oversampleLogicGateOutputsJ) {
+			oversampleGates |= json_boolean_value(oversampleLogicGateOutputsJ);
+		}
+
+		bool oversampleLogic = true;
+		json_t* oversampleLogicOutputsJ = json_object_get(rootJ, "oversampleLogicOutputs");
+		if (oversampleLogicOutputsJ) {
+			oversampleLogic = json_boolean_value(oversampleLogicOutputsJ);
+		}
+		oversampleLogic |= oversampleGates;
+
+		const bool oversampled[NUM_OVERSAMPLING_GROUPS] = {oversampleLogic, oversampleLogic, oversampleGates, oversampleTriggers};
+		for (int g = 0; g < NUM_OVERSAMPLING_GROUPS; g++) {
+			oversamplingIndex[g] = oversampled[g] ? index : 0;
+			autoOversampling[g] = oversampled[g] && autoRate;
 		}
 	}
 };
@@ -524,9 +1174,9 @@ struct CosmosPad : app::SvgSwitch {
 		// find distance from the centre of the pad
 		math::Vec c = box.size.div(2);
 		float dist = newPosition.minus(c).norm();
-		// and store (so pressure is 1 at centre and 0 at the edge)
+		// and send to the audio thread (so pressure is 1 at centre and 0 at the edge)
 		Cosmos* thisModule = static_cast<Cosmos*>(module);
-		thisModule->pressure[this->paramId] = 1.f - clamp(dist / c.x, 0.f, 1.f);
+		thisModule->pressure[this->paramId].push(1.f - clamp(dist / c.x, 0.f, 1.f));
 
 		e.consume(this);
 		SvgSwitch::onDragMove(e);
@@ -598,22 +1248,38 @@ struct CosmosWidget : ModuleWidget {
 
 		menu->addChild(createSubmenuItem("Oversampling", "",
 		[ = ](Menu * menu) {
-			menu->addChild(createIndexSubmenuItem("Oversampling rate",
-			{"Off", "x2", "x4", "x8"},
+			// a rate for each group of outputs (the inverted outputs follow theirs)
+			static const char* groupLabels[Cosmos::NUM_OVERSAMPLING_GROUPS] = {
+				"OR/AND outputs rate", "XOR outputs rate", "Gate outputs rate", "Trigger outputs rate"
+			};
+			for (int g = 0; g < Cosmos::NUM_OVERSAMPLING_GROUPS; g++) {
+				menu->addChild(createIndexSubmenuItem(groupLabels[g],
+				{"Off", "x2", "x4", "x8", "x16", "Auto"},
+				[ = ]() {
+					return module->autoOversampling[g] ? Cosmos::AUTO_OVERSAMPLING_MODE : module->oversamplingIndex[g];
+				},
+				[ = ](int mode) {
+					module->autoOversampling[g] = (mode == Cosmos::AUTO_OVERSAMPLING_MODE);
+					if (!module->autoOversampling[g]) {
+						module->oversamplingIndex[g] = mode;
+					}
+					module->requestOversampling();
+				}));
+			}
+			menu->addChild(createIndexSubmenuItem("Anti-aliasing filter quality",
+			{"Eco", "Standard", "High", "Low latency"},
 			[ = ]() {
-				return module->oversamplingIndex;
+				return module->oversamplingQuality;
 			},
-			[ = ](int mode) {
-				module->oversamplingIndex = mode;
-				// if oversampling is anything other than off, enable oversampling on logic outputs at least
-				if (mode > 0) {
-					module->oversampleLogicOutputs = true;
-				}
-				module->onSampleRateChange();
+			[ = ](int quality) {
+				module->oversamplingQuality = quality;
+				module->requestOversampling();
 			}));
-			menu->addChild(createBoolPtrMenuItem("Oversample logic outputs", "", &module->oversampleLogicOutputs));
-			menu->addChild(createBoolPtrMenuItem("Oversample logic gate outputs", "", &module->oversampleLogicGateOutputs));
-			menu->addChild(createBoolPtrMenuItem("Oversample logic trigger outputs", "", &module->oversampleLogicTriggerOutputs));
+			menu->addChild(createBoolPtrMenuItem("Antiderivative anti-aliasing on logic outputs", "instead of oversampling", &module->adaaLogicOutputs));
+			menu->addChild(createBoolPtrMenuItem("Band-limited gate and trigger outputs", "instead of oversampling", &module->polyBlepGateOutputs));
+			menu->addChild(new MenuSeparator());
+			menu->addChild(createMenuLabel(string::f("Latency: %.2f samples", module->getLogicLatency())));
+			menu->addChild(createBoolPtrMenuItem("Delay direct outputs to match", "", &module->alignDirectOutputs));
 		}));
 
 		menu->addChild(createBoolPtrMenuItem("Clip at ±10V", "", &module->clip10V));
@@ -0,0 +1,89 @@
+#pragma once
+#include <rack.hpp>
+
+// COSMOS' logic kernels, on blocks of channels (float_4 or float_8). Kept separate from the module so that the
+// offline analysis in bench/ runs exactly the same code.
+namespace cosmos {
+
+/** OR: the maximum of x and y */
+template <typename T>
+inline T logicOr(const T& x, const T& y) {
+	return ifelse(x > y, x, y);
+}
+
+/** AND: the minimum of x and y */
+template <typename T>
+inline T logicAnd(const T& x, const T& y) {
+	return ifelse(x > y, y, x);
+}
+
+/** XOR: the through-zero clipper, i.e. x clipped to ±|y|, inverted where y is positive */
+template <typename T>
+inline T logicXor(const T& x, const T& y) {
+	const T clip_x = ifelse(x > abs(y), abs(y), ifelse(x < -abs(y), -abs(y), x));
+	return ifelse(y > 0, -clip_x, clip_x);
+}
+
+/**
+    The integral of |u| t over t in [0, 1], along the straight line u = a + t (b - a). Where the line doesn't cross
+    zero |u| is linear on it, otherwise it's integrated either side of the crossing (where a and b have opposite
+    signs, so the crossing is well conditioned).
+*/
+template <typename T>
+inline T rampWeightedAbs(const T& a, const T& b) {
+	const T crossing = (a * b) < 0.f;
+	const T tc = a / ifelse(crossing, a - b, T(1.f));
+	const T crossed = abs(a) * tc * tc + abs(b) * (1.f - tc) * (2.f + tc);
+	return ifelse(crossing, crossed, abs(a + 2.f * b)) * (1.f / 6.f);
+}
+
+/**
+    Second order antiderivative anti-aliasing (ADAA) of the three logic kernels, at the base rate. They are all made of
+    s = x + y and |x - y|, |x + y|: OR = (s + |x - y|) / 2, AND = (s - |x - y|) / 2 and XOR = (|x - y| - |x + y|) / 2.
+    Each output is its kernel's integral, against a triangular kernel, over the straight lines joining the last three
+    inputs. As the kernels are piecewise linear this has a closed form, with no ill-conditioned differences of
+    antiderivatives. This delays the outputs by one sample.
+*/
+template <typename T>
+struct LogicADAA {
+	T sumHistory[2] = {};
+	T diffHistory[2] = {};
+
+	void reset() {
+		for (int i = 0; i < 2; i++) {
+			sumHistory[i] = 0.f;
+			diffHistory[i] = 0.f;
+		}
+	}
+
+	/** Copies the state of the first `numLanes` channels from an instance of another SIMD width */
+	template <typename U>
+	void copyLanes(const LogicADAA<U>& from, int numLanes) {
+		for (int i = 0; i < 2; i++) {
+			for (int l = 0; l < numLanes; l++) {
+				sumHistory[i][l] = from.sumHistory[i][l];
+				diffHistory[i][l] = from.diffHistory[i][l];
+			}
+		}
+	}
+
+	void process(const T& x, const T& y, T& orOut, T& andOut, T& xorOut) {
+		const T sum = x + y;
+		const T diff = x - y;
+		// the triangular kernel peaks at the previous input, and falls to zero at the one before and the current one, so
+		// on a straight line it weights the inputs by 1/6, 2/3 and 1/6
+		const T smoothSum = (sumHistory[0] + sum) * (1.f / 6.f) + sumHistory[1] * (2.f / 3.f);
+		const T smoothAbsSum = rampWeightedAbs(sumHistory[0], sumHistory[1]) + rampWeightedAbs(sum, sumHistory[1]);
+		const T smoothAbsDiff = rampWeightedAbs(diffHistory[0], diffHistory[1]) + rampWeightedAbs(diff, diffHistory[1]);
+		sumHistory[0] = sumHistory[1];
+		sumHistory[1] = sum;
+		diffHistory[0] = diffHistory[1];
+		diffHistory[1] = diff;
+
+		orOut = 0.5f * (smoothSum + smoothAbsDiff);
+		andOut = 0.5f * (smoothSum - smoothAbsDiff);
+		xorOut = 0.5f * (smoothAbsDiff - smoothAbsSum);
+	}
+};
+
+} // namespace cosmos
@@ -1,5 +1,6 @@
 #include "plugin.hpp"
 #include "ChowDSP.hpp"
+#include "SlewLFOCore.hpp"
 
 using namespace simd;
 
@@ -41,10 +42,6 @@ struct SlewLFO : Module {
 		LFO,
 		SLEW
 	};
-	enum LFOState {
-		RISING,
-		FALLING
-	};
 
 	SlewLFO() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
@@ -64,11 +61,42 @@ struct SlewLFO : Module {
 	}
 
 	void onSampleRateChange() override {
-		float sampleRate = APP->engine->getSampleRate();
-		for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
-			oversampler[c].setOversamplingIndex(oversamplingIndex);
-			oversampler[c].reset(sampleRate);
+		// process() isn't running meanwhile, so the settings are applied at once (superseding any queued ones)
+		oversamplingSwitch.reset();
+		applyOversampling(getOversamplingSettings(), APP->engine->getSampleRate());
+	}
+
+	// the settings as chosen in the menu, which only process() applies to the downsampler
+	OversamplingSettings getOversamplingSettings() const {
+		OversamplingSettings settings;
+		settings.index = oversamplingIndex;
+		settings.autoRate = autoOversampling;
+		settings.quality = oversamplingQuality;
+		return settings;
+	}
+
+	// called from the menu (UI thread) after changing the settings
+	void requestOversampling() {
+		oversamplingSwitch.request(getOversamplingSettings());
+	}
+
+	// configures the downsampler, from the audio thread (or while it isn't running), which doesn't allocate. If it
+	// changed, each channel carries on from its current output rather than from 0V, so the output doesn't jump
+	void applyOversampling(const OversamplingSettings& settings, float sampleRate) {
+		int index = settings.index;
+		if (settings.autoRate) {
+			index = chowdsp::getOversamplingIndexForRate(sampleRate, autoOversamplingRate);
 		}
+		const int oldIndex = downsampler.getOversamplingIndex();
+		const chowdsp::FilterQuality oldQuality = downsampler.getQuality();
+		downsampler.setQuality((chowdsp::FilterQuality) settings.quality);
+		downsampler.setOversamplingIndex(index);
+		if (downsampler.getOversamplingIndex() != oldIndex || downsampler.getQuality() != oldQuality) {
+			for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+				downsampler.settle(c, out[c]);
+			}
+		}
+		wakeChannels = true;
 	}
 
 	void updateKnobSettingsForMode(SlewLFOMode mode) {
@@ -88,13 +116,15 @@ struct SlewLFO : Module {
 		params[FALL_PARAM].setValue(getParamQuantity(FALL_PARAM)->defaultValue);
 	}
 
-	inline double crossfade(double a, double b, double p) {
-		return a + (b - a) * p;
-	}
-
-	// oversampling
-	chowdsp::VariableOversampling<6, double> oversampler[PORT_MAX_CHANNELS]; 	// uses a 2*6=12th order Butterworth filter
+	// oversampling, all channels are downsampled together
+	chowdsp::HalfbandDownsamplingBank<PORT_MAX_CHANNELS, 6, double> downsampler; 	// polyphase halfband cascade, ~80dB rejection
 	int oversamplingIndex = 2; 	// default is 2^oversamplingIndex == x4 oversampling
+	bool autoOversampling = false; 	// if set, oversamplingIndex is chosen to reach autoOversamplingRate
+	// menu entry after the fixed oversampling rates
+	static constexpr int AUTO_OVERSAMPLING_MODE = 5;
+	int oversamplingQuality = chowdsp::STANDARD;
+	// hands changes of the above oversampling settings to the audio thread
+	OversamplingSwitch oversamplingSwitch;
 	bool removeDCAtAudioRates = true;
 	dsp::ClockDivider updateCounter;
 
@@ -102,6 +132,12 @@ struct SlewLFO : Module {
 	double phase[PORT_MAX_CHANNELS] = {};
 	bool state[PORT_MAX_CHANNELS] = {}; // false = rise, true = fall
 
+	// channels that have slewed to a constant input are skipped, keeping their output, until the input changes
+	TBlockActivity<double, 2> activity[PORT_MAX_CHANNELS];
+	// the settings shared by the channels when last processed, any change of which wakes them all
+	uint32_t channelSettingsKey = ~0u;
+	bool wakeChannels = true;
+
 	std::pair<double, double> getMinMaxSlewRates(RateMode rate, CapacitorModifier capacitor) {
 
 		double slowestTime, fastestTime;
@@ -152,8 +188,21 @@ struct SlewLFO : Module {
 		const int numPolyphonyEngines = std::max({1, inputs[IN_INPUT].getChannels(), inputs[RISE_INPUT].getChannels(), inputs[FALL_INPUT].getChannels()});
 		outputs[OUT_OUTPUT].setChannels(numPolyphonyEngines);
 
+		// oversampling changes from the menu are made between frames, crossfading the oversampled output
+		OversamplingSettings newSettings;
+		if (oversamplingSwitch.process(newSettings, rate == FAST && downsampler.getOversamplingRatio() > 1, args.sampleTime)) {
+			applyOversampling(newSettings, args.sampleRate);
+		}
+
+		// a change of anything shared by the channels wakes any idle ones (the knobs and CV only set the slew rates,
+		// which don't matter to a channel that has reached its input)
+		const uint32_t settingsKey = mode | rate << 1 | numPolyphonyEngines << 2;
+		const bool wake = wakeChannels || settingsKey != channelSettingsKey || oversamplingSwitch.gain != 1.f;
+		channelSettingsKey = settingsKey;
+		wakeChannels = false;
+
 		// oversampling parts
-		const int oversamplingRatio = oversampler[0].getOversamplingRatio();
+		const int oversamplingRatio = downsampler.getOversamplingRatio();
 		const bool oversampleOutput = (rate == FAST) && (oversamplingRatio > 1);
 		const int oversampleRatioMain = (rate == FAST) ? oversamplingRatio : 1;
 		const double sampleTimeOversample = args.sampleTime / oversampleRatioMain;
@@ -164,9 +213,19 @@ struct SlewLFO : Module {
 		}
 
 
+		int activeChannels = 0;
 		for (int c = 0; c < numPolyphonyEngines; c++) {
+			// only a slewing channel goes idle, once its output has reached its input (an LFO's output never holds)
+			const double activityInputs[2] = {(mode == SLEW) ? inputs[IN_INPUT].getPolyVoltage(c) : 0., out[c]};
+			if (wake) {
+				activity[c].wake();
+			}
+			if (!activity[c].process(activityInputs)) {
+				continue;
+			}
+			activeChannels |= 1 << c;
 
-			double* outBuffer = oversampler[c].getOSBuffer();
+			double* outBuffer = downsampler.getOSBuffer(c);
 			for (int i = 0; i < oversampleRatioMain; i++) {
 				double remainder = processForChannel(c, mode, slewMin, slewMax, shapeScale, shape, param_rise, param_fall, sampleTimeOversample);
 
@@ -175,8 +234,18 @@ struct SlewLFO : Module {
 				}
 				outBuffer[i] = out[c];
 			}
+		}
 
-			const double outDownsampled = oversampleOutput ? oversampler[c].downsample() : out[c];
+		double outDownsampledChannels[PORT_MAX_CHANNELS];
+		if (oversampleOutput) {
+			downsampler.downsample(outDownsampledChannels, activeChannels);
+		}
+		for (int c = 0; c < numPolyphonyEngines; c++) {
+			if (!(activeChannels >> c & 1)) {
+				continue;
+			}
+			// crossfaded with the last oversampled value while the oversampling settings change (gain is 1 otherwise)
+			const double outDownsampled = oversampleOutput ? out[c] + oversamplingSwitch.gain * (outDownsampledChannels[c] - out[c]) : out[c];
 			if (removeDCAtAudioRates && rate == FAST && mode == LFO) {
 				outputs[OUT_OUTPUT].setVoltage(outDownsampled - 5.f, c);
 			}
@@ -204,17 +273,8 @@ struct SlewLFO : Module {
 
 	double processForChannel(int c, SlewLFOMode mode, double slewMin, double slewMax, double shapeScale, double shape, double param_rise, double param_fall, double sampleTime) {
 
-		double in;
-		switch (mode) {
-			case SLEW:	{
-				in = inputs[IN_INPUT].getPolyVoltage(c);
-				break;
-			}
-			case LFO: {
-				in = state[c] ? 0. : 10.;
-				break;
-			}
-		}
+		// the input is only used in slew mode (the LFO heads for 0V or 10V)
+		const double in = (mode == SLEW) ? inputs[IN_INPUT].getPolyVoltage(c) : 0.;
 
 		double riseCV = 0.0, fallCV = 0.0;
 		if (inputs[RISE_INPUT].isConnected()) {
@@ -227,65 +287,37 @@ struct SlewLFO : Module {
 		riseCV += param_rise;
 		fallCV += param_fall;
 
-		double delta = in - out[c];
-		double rateCV = 0.0;
-		if (delta > 0.0) {
-			rateCV = riseCV;
-		}
-		else if (delta < 0.0) {
-			rateCV = fallCV;
-		}
-		rateCV *= 0.1;
-
-		double pm_one = (delta > 0) - (delta < 0);
-		double slew = slewMax * std::pow(slewMin / slewMax, rateCV);
-
-		double diff = slew * crossfade(pm_one, shapeScale * delta, shape) * sampleTime;
-
-		out[c] += diff;
-
-		if (mode == SLEW) {
-			out[c] = (delta > 0 && (out[c] > in)) ? in : out[c];
-			out[c] = (delta < 0 && (out[c] < in)) ? in : out[c];
-		}
-		else {
-			if (out[c] >= 10.) {
-				state[c] = FALLING;
-
-				double remainder = (out[c] - in) / diff;
-				out[c] = 10.;
-
-				return remainder * sampleTime;
-			}
-			else if (out[c] <= 0.) {
-				state[c] = RISING;
-
-				double remainder = (out[c] - in) / diff;
-				out[c] = 0.;
-
-				return remainder * sampleTime;
-			}
-
-		}
-		return 0.;
+		return slewlfo::processStep(out[c], state[c], mode == LFO, in, riseCV, fallCV, slewMin, slewMax, shapeScale, shape, sampleTime);
 	}
 
 	json_t* dataToJson() override {
 		json_t* rootJ = json_object();
 		json_object_set_new(rootJ, "removeDCAtAudioRates", json_boolean(removeDCAtAudioRates));
-		json_object_set_new(rootJ, "oversamplingIndex", json_integer(oversampler[0].getOversamplingIndex()));
+		json_object_set_new(rootJ, "oversamplingIndex", json_integer(downsampler.getOversamplingIndex()));
+		json_object_set_new(rootJ, "autoOversampling", json_boolean(autoOversampling));
+		json_object_set_new(rootJ, "oversamplingQuality", json_integer(oversamplingQuality));
 
 		return rootJ;
 	}
 
 	void dataFromJson(json_t* rootJ) override {
 
+		json_t* oversamplingQualityJ = json_object_get(rootJ, "oversamplingQuality");
+		if (oversamplingQualityJ) {
+			oversamplingQuality = clamp((int) json_integer_value(oversamplingQualityJ), 0, chowdsp::NUM_QUALITIES - 1);
+		}
+
 		json_t* oversamplingIndexJ = json_object_get(rootJ, "oversamplingIndex");
 		if (oversamplingIndexJ) {
 			oversamplingIndex = json_integer_value(oversamplingIndexJ);
-			onSampleRateChange();
 		}
 
+		json_t* autoOversamplingJ = json_object_get(rootJ, "autoOversampling");
+		if (autoOversamplingJ) {
+			autoOversampling = json_boolean_value(autoOversamplingJ);
+		}
+		onSampleRateChange();
+
 		json_t* removeDCAtAudioRatesJ = json_object_get(rootJ, "removeDCAtAudioRates");
 		if (removeDCAtAudioRatesJ) {
 			removeDCAtAudioRates = json_boolean_value(removeDCAtAudioRatesJ);
@@ -348,14 +380,31 @@ struct SlewLFOWidget : ModuleWidget {
 		menu->addChild(new MenuSeparator());
 
 		menu->addChild(createIndexSubmenuItem("Oversampling (fast mode only)",
-		{"Off", "x2", "x4", "x8", "x16"},
+		{"Off", "x2", "x4", "x8", "x16", "Auto"},
 		[ = ]() {
-			return module->oversamplingIndex;
+			return module->autoOversampling ? SlewLFO::AUTO_OVERSAMPLING_MODE : module->oversamplingIndex;
 		},
 		[ = ](int mode) {
-			module->oversamplingIndex = mode;
-			module->onSampleRateChange();
+			module->autoOversampling = (mode == SlewLFO::AUTO_OVERSAMPLING_MODE);
+			if (!module->autoOversampling) {
+				module->oversamplingIndex = mode;
+			}
+			module->requestOversampling();
+		}));
+
+		menu->addChild(createIndexSubmenuItem("Oversampling filter quality",
+		{"Eco", "Standard", "High", "Low latency"},
+		[ = ]() {
+			return module->oversamplingQuality;
+		},
+		[ = ](int quality) {
+			module->oversamplingQuality = quality;
+			module->requestOversampling();
 		}));
+		// only the output is oversampled (the inputs are held), so only downsampling adds latency
+		if (module->downsampler.getOversamplingRatio() > 1) {
+			menu->addChild(createMenuLabel(string::f("Oversampling latency: %.2f samples", module->downsampler.getDownsamplingLatency())));
+		}
 
 		menu->addChild(createBoolPtrMenuItem("Centre waveform at audio rates", "", &module->removeDCAtAudioRates));
 	}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cmath>
+
+// SlewLFO's slew/LFO core for a single channel. Kept separate from the module so that the offline analysis in
+// bench/ runs exactly the same code.
+namespace slewlfo {
+
+inline double crossfade(double a, double b, double p) {
+	return a + (b - a) * p;
+}
+
+/**
+    Advances `out` by `sampleTime` seconds: towards `in` in slew mode, or in LFO mode (where `in` is ignored)
+    towards 10V while rising and 0V while `falling`. Slew rates are in volts per second, riseCV/fallCV are 0-10V
+    (slowest at 10V) and `shape` crossfades from a linear to an exponential slew.
+
+    Returns the time left over when the LFO turns around within the step (to be processed with another call), or 0.
+*/
+inline double processStep(double& out, bool& falling, bool lfo, double in, double riseCV, double fallCV,
+                          double slewMin, double slewMax, double shapeScale, double shape, double sampleTime) {
+	if (lfo) {
+		in = falling ? 0. : 10.;
+	}
+
+	double delta = in - out;
+	double rateCV = 0.0;
+	if (delta > 0.0) {
+		rateCV = riseCV;
+	}
+	else if (delta < 0.0) {
+		rateCV = fallCV;
+	}
+	rateCV *= 0.1;
+
+	double pm_one = (delta > 0) - (delta < 0);
+	double slew = slewMax * std::pow(slewMin / slewMax, rateCV);
+
+	double diff = slew * crossfade(pm_one, shapeScale * delta, shape) * sampleTime;
+
+	out += diff;
+
+	if (!lfo) {
+		out = (delta > 0 && (out > in)) ? in : out;
+		out = (delta < 0 && (out < in)) ? in : out;
+	}
+	else {
+		if (out >= 10.) {
+			falling = true;
+
+			double remainder = (out - in) / diff;
+			out = 10.;
+
+			return remainder * sampleTime;
+		}
+		else if (out <= 0.) {
+			falling = false;
+
+			double remainder = (out - in) / diff;
+			out = 0.;
+
+			return remainder * sampleTime;
+		}
+
+	}
+	return 0.;
+}
+
+} // namespace slewlfo
@@ -0,0 +1,163 @@
+#pragma once
+#include <rack.hpp>
+
+// AVX2 variants of the SIMD kernels are compiled as target specific functions on x86-64, and selected at runtime
+// if the CPU supports them. Not on Windows, where GCC doesn't keep the stack 32-byte aligned for spilled AVX registers.
+#if defined(__x86_64__) && !defined(_WIN32)
+#define SIMD8_AVX2 1
+#endif
+
+// AVX2 kernels are flattened, so that the float_8 code they use is inlined (and compiled with AVX2 enabled).
+// FMA isn't enabled, so that results are bit identical to the SSE kernels.
+#ifdef SIMD8_AVX2
+#define SIMD8_AVX2_TARGET __attribute__((target("avx2"), flatten))
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+// float_8 is passed by value between inlined functions only, so the ABI difference with/without AVX doesn't matter
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace simd8 {
+
+/**
+    8 lane float vector, with the same interface as `simd::float_4` (so it can be used with Rack's templated DSP
+    code and `Port::getVoltageSimd()` etc.). Uses compiler vector extensions, so it compiles to AVX instructions
+    in AVX2 target functions, and to pairs of SSE instructions elsewhere.
+*/
+struct float_8 {
+	// 16 byte alignment (as float_4), so containers and `new` don't need over-aligned allocation
+	typedef float type8 __attribute__((vector_size(32), aligned(16)));
+	typedef int32_t int8 __attribute__((vector_size(32), aligned(16)));
+
+	using type = float;
+	constexpr static int size = 8;
+
+	// the bits are a member rather than returned by a function, as returning a bare 32 byte vector from a function
+	// compiled without AVX warns (-Wpsabi) at the end of the translation unit, after the pragmas here are popped
+	union {
+		type8 v;
+		int8 bits;
+		float s[8];
+	};
+
+	float_8() = default;
+	float_8(const type8& v) : v(v) {}
+	float_8(float x) {
+		v = type8{x, x, x, x, x, x, x, x};
+	}
+	float_8(float x1, float x2, float x3, float x4, float x5, float x6, float x7, float x8) {
+		v = type8{x1, x2, x3, x4, x5, x6, x7, x8};
+	}
+
+	static float_8 zero() {
+		return float_8(0.f);
+	}
+	static float_8 mask() {
+		return float_8((type8) (int8{} - 1));
+	}
+	static float_8 load(const float* x) {
+		float_8 r;
+		std::memcpy(&r.v, x, sizeof(r.v));
+		return r;
+	}
+	void store(float* x) {
+		std::memcpy(x, &v, sizeof(v));
+	}
+
+	float& operator[](int i) {
+		return s[i];
+	}
+	const float& operator[](int i) const {
+		return s[i];
+	}
+
+	static float_8 fromBits(const int8& b) {
+		return float_8((type8) b);
+	}
+};
+
+#define SIMD8_OP(op) \
+	inline float_8 operator op(const float_8& a, const float_8& b) { return float_8(a.v op b.v); } \
+	inline float_8& operator op##=(float_8& a, const float_8& b) { a = a op b; return a; }
+SIMD8_OP(+)
+SIMD8_OP(-)
+SIMD8_OP(*)
+SIMD8_OP(/)
+#undef SIMD8_OP
+
+#define SIMD8_BITOP(op) \
+	inline float_8 operator op(const float_8& a, const float_8& b) { return float_8::fromBits(a.bits op b.bits); } \
+	inline float_8& operator op##=(float_8& a, const float_8& b) { a = a op b; return a; }
+SIMD8_BITOP(&)
+SIMD8_BITOP(|)
+SIMD8_BITOP(^)
+#undef SIMD8_BITOP
+
+// comparisons return masks (all bits set where true), as for float_4
+#define SIMD8_CMP(op) \
+	inline float_8 operator op(const float_8& a, const float_8& b) { return float_8::fromBits(a.v op b.v); }
+SIMD8_CMP(==)
+SIMD8_CMP(!=)
+SIMD8_CMP(<)
+SIMD8_CMP(<=)
+SIMD8_CMP(>)
+SIMD8_CMP(>=)
+#undef SIMD8_CMP
+
+inline float_8 operator-(const float_8& a) {
+	return float_8(-a.v);
+}
+inline float_8 operator+(const float_8& a) {
+	return a;
+}
+inline float_8 operator~(const float_8& a) {
+	return float_8::fromBits(~a.bits);
+}
+
+inline float_8 andnot(const float_8& a, const float_8& b) {
+	return float_8::fromBits(~a.bits & b.bits);
+}
+inline float_8 ifelse(const float_8& mask, const float_8& a, const float_8& b) {
+	return (mask & a) | andnot(mask, b);
+}
+inline int movemask(const float_8& a) {
+	// one vmovmskps with AVX, two movmskps otherwise
+	typedef float type4 __attribute__((vector_size(16)));
+	const type4 lo = {a.v[0], a.v[1], a.v[2], a.v[3]};
+	const type4 hi = {a.v[4], a.v[5], a.v[6], a.v[7]};
+	return _mm_movemask_ps((__m128) lo) | (_mm_movemask_ps((__m128) hi) << 4);
+}
+
+inline float_8 fmax(const float_8& a, const float_8& b) {
+	return ifelse(a > b, a, b);
+}
+inline float_8 fmin(const float_8& a, const float_8& b) {
+	return ifelse(a < b, a, b);
+}
+inline float_8 clamp(const float_8& x, const float_8& a = 0.f, const float_8& b = 1.f) {
+	return fmin(fmax(x, a), b);
+}
+inline float_8 abs(const float_8& a) {
+	return float_8::fromBits(a.bits & 0x7fffffff);
+}
+inline float_8 sgn(const float_8& x) {
+	return (x & -0.f) | 1.f;
+}
+
+/** Whether the CPU running the plugin supports the AVX2 variants */
+inline bool cpuSupportsAVX2() {
+#ifdef SIMD8_AVX2
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+} // namespace simd8
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
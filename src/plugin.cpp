@@ -1,11 +1,14 @@
 #include "plugin.hpp"
+#include "float_8.hpp"
 
 
 Plugin* pluginInstance;
+bool useAVX2Kernels = false;
 
 
 void init(Plugin* p) {
 	pluginInstance = p;
+	useAVX2Kernels = simd8::cpuSupportsAVX2();
 
 	// Add modules here
 	p->addModel(modelCosmos);
@@ -12,9 +12,174 @@ extern Model* modelCosmos;
 extern Model* modelGomaII;
 extern Model* modelSlewLFO;
 
-/** When triggered, holds a high value for a specified time before going low again */
-struct PulseGenerator_4 {
-	simd::float_4 remaining = 0.f;
+// Whether the AVX2 (8 lane) variants of the SIMD kernels are used, decided once when the plugin is loaded
+extern bool useAVX2Kernels;
+
+// The internal (oversampled) rate targeted by the "Auto" oversampling setting, so the CPU cost doesn't grow with the engine sample rate
+static constexpr float autoOversamplingRate = 176400.f;
+
+// Oversampling settings as chosen in a module's menu
+struct OversamplingSettings {
+	int index = 2; 				// 2^index is the oversampling factor
+	bool autoRate = false; 		// if set, index is chosen to reach autoOversamplingRate instead
+	int quality = 1; 			// chowdsp::FilterQuality
+};
+
+/**
+    Passes oversampling settings from the UI thread to the audio thread, through a lock-free queue, and switches
+    between them without clicks: the oversampled signal is crossfaded out to the base rate one, the new settings are
+    applied at a frame boundary, and then it's crossfaded back in. Nothing is allocated or reset on the UI thread.
+    `Settings` is `OversamplingSettings`, or a module's own struct of them (e.g. one per group of outputs).
+*/
+template <typename Settings>
+struct TOversamplingSwitch {
+	enum Phase {
+		STEADY,
+		FADE_OUT,
+		FADE_IN
+	};
+
+	dsp::RingBuffer<Settings, 16> requests;
+	Settings next;
+	bool pending = false;
+	Phase phase = STEADY;
+	// weight of the oversampled signal against the base rate one
+	float gain = 1.f;
+
+	/** Queues new settings (UI thread). Returns false, dropping them, if the audio thread hasn't kept up. */
+	bool request(const Settings& settings) {
+		if (requests.full()) {
+			return false;
+		}
+		requests.push(settings);
+		return true;
+	}
+
+	/** Drops any queued settings and ends any fade (audio thread, or while it isn't running) */
+	void reset() {
+		while (!requests.empty()) {
+			requests.shift();
+		}
+		pending = false;
+		phase = STEADY;
+		gain = 1.f;
+	}
+
+	/**
+	    Advances by one frame (audio thread). Returns true if the latest requested settings, written to `settings`,
+	    should be applied before processing this frame. If `crossfade` is false (nothing oversampled is being output),
+	    they are applied at once. Each half of the crossfade takes `fadeTime` seconds.
+	*/
+	bool process(Settings& settings, bool crossfade, float sampleTime, float fadeTime = 5e-3f) {
+		while (!requests.empty()) {
+			next = requests.shift();
+			pending = true;
+		}
+		const float step = sampleTime / fadeTime;
+
+		// a request during a fade in turns it around from where it is
+		if (pending) {
+			phase = FADE_OUT;
+			gain = crossfade ? gain - step : 0.f;
+			if (gain <= 0.f) {
+				gain = 0.f;
+				settings = next;
+				pending = false;
+				phase = FADE_IN;
+				return true;
+			}
+		}
+		else if (phase == FADE_IN) {
+			gain += step;
+			if (gain >= 1.f) {
+				gain = 1.f;
+				phase = STEADY;
+			}
+		}
+		return false;
+	}
+};
+
+typedef TOversamplingSwitch<OversamplingSettings> OversamplingSwitch;
+
+/**
+    A control value set from the UI thread (e.g. by dragging on a pad), passed to the audio thread through a lock-free
+    single producer queue of events stamped with the time they were made. Each event is placed one engine block after
+    that time (blocks aren't processed ahead of real time, so it has been read by then) and ramped to over the time
+    since the previous one, up to `maxRampTime`. The signal is smooth, and its timing follows the gestures rather
+    than the UI frames or when the audio thread happened to read them.
+
+    This delays the control by one engine block (e.g. 5.3ms for 256 frame blocks at 48kHz), and each ramp reaches its
+    event's value as the next event is due, i.e. one UI frame later while dragging.
+*/
+struct ControlEventStream {
+	struct Event {
+		float value;
+		double time; 	// system::getTime() when it was made
+	};
+
+	dsp::RingBuffer<Event, 64> events;
+	// the event read from the queue, waiting for its frame
+	Event next;
+	int64_t nextFrame = 0;
+	bool pending = false;
+	double lastTime = -INFINITY;
+	// the engine block that `frame` is in, read once per block: it started at blockTime, on blockFrame
+	double blockTime = 0.0;
+	int64_t blockFrame = 0;
+	int64_t blockEndFrame = 0;
+	// the ramp being output
+	float from = 0.f;
+	float to = 0.f;
+	int64_t rampStart = 0;
+	float rampFrames = 1.f;
+	float value = 0.f;
+
+	/** Queues a new value (UI thread). Returns false, dropping it, if the audio thread hasn't kept up. */
+	bool push(float newValue) {
+		if (events.full()) {
+			return false;
+		}
+		events.push({newValue, system::getTime()});
+		return true;
+	}
+
+	/**
+	 * Returns the value at engine frame `frame` (audio thread, called every frame). `maxRampTime` bounds the ramp
+	 * after a pause in the events, and is above the UI frame time, so ramps span the whole time between drag events.
+	 */
+	float process(int64_t frame, float sampleRate, float maxRampTime = 50e-3f) {
+		if (!pending && !events.empty()) {
+			if (frame >= blockEndFrame) {
+				auto* engine = APP->engine;
+				blockTime = engine->getBlockTime();
+				blockFrame = engine->getBlockFrame();
+				blockEndFrame = blockFrame + engine->getBlockFrames();
+			}
+			next = events.shift();
+			const double sinceBlock = next.time - blockTime;
+			nextFrame = blockEndFrame + (int64_t) std::floor(sinceBlock * sampleRate);
+			pending = true;
+		}
+		if (pending && frame >= nextFrame) {
+			// ramps on from the current value (an event that is late, e.g. after the engine stalled, starts now)
+			from = value;
+			to = next.value;
+			rampStart = frame;
+			rampFrames = std::max(1.f, (float) std::min(next.time - lastTime, (double) maxRampTime) * sampleRate);
+			lastTime = next.time;
+			pending = false;
+		}
+		const float t = std::min((frame - rampStart) / rampFrames, 1.f);
+		value = from + (to - from) * t;
+		return value;
+	}
+};
+
+/** When triggered, holds a high value for a specified time before going low again (for any SIMD type T) */
+template <typename T>
+struct TPulseGenerator {
+	T remaining = 0.f;
 
 	/** Immediately disables the pulse */
 	void reset() {
@@ -22,31 +187,282 @@ struct PulseGenerator_4 {
 	}
 
 	/** Advances the state by `deltaTime`. Returns whether the pulse is in the HIGH state. */
-	simd::float_4 process(float deltaTime) {
+	T process(float deltaTime) {
 
-		simd::float_4 mask = (remaining > 0.f);
+		T mask = (remaining > 0.f);
 
 		remaining -= ifelse(mask, deltaTime, 0.f);
-		return ifelse(mask, simd::float_4::mask(), 0.f);
+		return ifelse(mask, T::mask(), 0.f);
 	}
 
 	/** Begins a trigger with the given `duration`. */
-	void trigger(simd::float_4 mask, float duration = 1e-3f) {
+	void trigger(T mask, float duration = 1e-3f) {
 		// Keep the previous pulse if the existing pulse will be held longer than the currently requested one.
 		remaining = ifelse(mask & (duration > remaining), duration, remaining);
 	}
 };
 
-struct BooleanTrigger_4 {
-	simd::float_4 previousMask = 0.f;
+template <typename T>
+struct TBooleanTrigger {
+	T previousMask = 0.f;
 
-	simd::float_4 process(simd::float_4 mask) {
-		simd::float_4 result = simd::andnot(previousMask, mask);
+	T process(T mask) {
+		T result = andnot(previousMask, mask);
 		previousMask = mask;
 		return result;
 	}
 };
 
+/**
+    N Schmitt triggers (as `dsp::TSchmittTrigger`, with thresholds 0 and 1), each starting a pulse (as `TPulseGenerator`)
+    when it triggers, for one block of channels. The states are stored as structure of arrays, so all N signals are
+    updated in one pass, which the compiler unrolls and keeps in registers (for any SIMD type T).
+*/
+template <typename T, int N>
+struct TTriggerPulseBank {
+	T schmittState[N];
+	T remaining[N];
+
+	TTriggerPulseBank() {
+		reset();
+	}
+
+	void reset() {
+		for (int k = 0; k < N; k++) {
+			// high, so that inputs which are already high don't trigger, as dsp::TSchmittTrigger
+			schmittState[k] = T::mask();
+			remaining[k] = 0.f;
+		}
+	}
+
+	/** Copies the state of the first `numLanes` channels from a bank of another SIMD width */
+	template <typename U>
+	void copyLanes(const TTriggerPulseBank<U, N>& from, int numLanes) {
+		for (int k = 0; k < N; k++) {
+			for (int l = 0; l < numLanes; l++) {
+				schmittState[k][l] = from.schmittState[k][l];
+				remaining[k][l] = from.remaining[k][l];
+			}
+		}
+	}
+
+	/** Processes the N inputs `in`, and advances the pulses by `deltaTime`, writing them (0 or `high`) to `out` */
+	void process(const T* in, T* out, float deltaTime, float duration = 1e-3f, float high = 10.f) {
+		for (int k = 0; k < N; k++) {
+			const T on = in[k] >= 1.f;
+			const T off = in[k] <= 0.f;
+			const T triggered = andnot(schmittState[k], on);
+			schmittState[k] = on | andnot(off, schmittState[k]);
+
+			remaining[k] = ifelse(triggered & (duration > remaining[k]), duration, remaining[k]);
+			const T pulse = remaining[k] > 0.f;
+			remaining[k] -= ifelse(pulse, deltaTime, 0.f);
+			out[k] = ifelse(pulse, high, 0.f);
+		}
+	}
+};
+
+/**
+    Band-limited step corrections (2 point polyBLEP), for a step of `height` at `alpha` (0 to 1) through the
+    interval between the previous and the current sample. `before` is added to the previous sample, `after` to the current one.
+*/
+template <typename T>
+inline void polyBlepStep(const T& height, const T& alpha, T& before, T& after) {
+	before += 0.5f * height * (1.f - alpha) * (1.f - alpha);
+	after -= 0.5f * height * alpha * alpha;
+}
+
+/**
+    The gate of `input > threshold` at the base rate, with polyBLEP corrected edges. The crossing time is found by
+    linear interpolation of the input. The correction reaches back one sample, so the output is one sample late.
+    The last edges (naive, i.e. without correction) are kept for deriving triggers (for any SIMD type T).
+*/
+template <typename T>
+struct TPolyBlepGate {
+	T previousInput = 0.f;
+	T previousGate = 0.f;
+	T pending = 0.f;
+	// edges between the previous and current sample, and where they were in the interval (0 to 1)
+	T rising = 0.f;
+	T falling = 0.f;
+	T alpha = 0.f;
+
+	void reset() {
+		previousInput = 0.f;
+		previousGate = 0.f;
+		pending = 0.f;
+		rising = 0.f;
+		falling = 0.f;
+		alpha = 0.f;
+	}
+
+	/** Copies the state of the first `numLanes` channels from a gate of another SIMD width */
+	template <typename U>
+	void copyLanes(const TPolyBlepGate<U>& from, int numLanes) {
+		for (int l = 0; l < numLanes; l++) {
+			previousInput[l] = from.previousInput[l];
+			previousGate[l] = from.previousGate[l];
+			pending[l] = from.pending[l];
+			rising[l] = from.rising[l];
+			falling[l] = from.falling[l];
+			alpha[l] = from.alpha[l];
+		}
+	}
+
+	T process(T input, float threshold, float high = 10.f) {
+		const T gate = ifelse(input > threshold, high, 0.f);
+		rising = gate > previousGate;
+		falling = gate < previousGate;
+		const T edge = rising | falling;
+		alpha = clamp((threshold - previousInput) / ifelse(edge, input - previousInput, 1.f), 0.f, 1.f);
+
+		T before = 0.f, after = 0.f;
+		polyBlepStep<T>(ifelse(edge, gate - previousGate, 0.f), alpha, before, after);
+		const T output = previousGate + pending + before;
+		pending = after;
+		previousInput = input;
+		previousGate = gate;
+		return output;
+	}
+};
+
+/**
+    As `TPulseGenerator`, holding `high` for `duration` after each trigger, but with triggers at a fraction `alpha`
+    (0 to 1) through the sample interval, and polyBLEP corrected edges. The output is one sample late, to line up
+    with `TPolyBlepGate`.
+*/
+template <typename T>
+struct TPolyBlepPulse {
+	T remaining = 0.f; // time until the pulse ends, from the previous sample
+	T pending = 0.f;
+
+	void reset() {
+		remaining = 0.f;
+		pending = 0.f;
+	}
+
+	/** Copies the state of the first `numLanes` channels from a pulse of another SIMD width */
+	template <typename U>
+	void copyLanes(const TPolyBlepPulse<U>& from, int numLanes) {
+		for (int l = 0; l < numLanes; l++) {
+			remaining[l] = from.remaining[l];
+			pending[l] = from.pending[l];
+		}
+	}
+
+	T process(T trigger, T alpha, float deltaTime, float duration = 1e-3f, float high = 10.f) {
+		const T wasHigh = remaining > 0.f;
+		// as TPulseGenerator, a trigger keeps the previous pulse if it would be held longer
+		T end = ifelse(trigger, fmax(remaining, alpha * deltaTime + duration), remaining);
+		const T rising = andnot(wasHigh, trigger);
+		const T falling = andnot(rising, (end > 0.f) & (end <= deltaTime));
+
+		T before = 0.f, after = 0.f;
+		polyBlepStep<T>(ifelse(rising, high, 0.f), alpha, before, after);
+		polyBlepStep<T>(ifelse(falling, -high, 0.f), end / deltaTime, before, after);
+		const T output = ifelse(wasHigh, high, 0.f) + pending + before;
+		pending = after;
+		remaining = fmax(end - deltaTime, 0.f);
+		return output;
+	}
+};
+
+/** Delays a signal by a fractional number of samples (up to N - 2), with linear interpolation (for any SIMD type T) */
+template <typename T, int N = 8>
+struct TFractionalDelay {
+	static_assert((N & (N - 1)) == 0, "N must be a power of 2");
+	T history[N] = {};
+	int writeIndex = 0;
+
+	void reset() {
+		for (int i = 0; i < N; i++) {
+			history[i] = 0.f;
+		}
+		writeIndex = 0;
+	}
+
+	/** Copies the history of the first `numLanes` channels from a delay of another SIMD width */
+	template <typename U>
+	void copyLanes(const TFractionalDelay<U, N>& from, int numLanes) {
+		for (int i = 0; i < N; i++) {
+			for (int l = 0; l < numLanes; l++) {
+				history[(writeIndex + i) & (N - 1)][l] = from.history[(from.writeIndex + i) & (N - 1)][l];
+			}
+		}
+	}
+
+	/** Pushes `x`, and returns the input from `delay` samples ago */
+	T process(T x, float delay) {
+		history[writeIndex] = x;
+		delay = clamp(delay, 0.f, (float)(N - 2));
+		const int whole = (int) delay;
+		const float fraction = delay - whole;
+		const T newer = history[(writeIndex - whole) & (N - 1)];
+		const T older = history[(writeIndex - whole - 1) & (N - 1)];
+		writeIndex = (writeIndex + 1) & (N - 1);
+		return newer + fraction * (older - newer);
+	}
+};
+
+/**
+    Activity of a block of polyphony channels (a SIMD type T, or a single channel as a double), for skipping blocks
+    whose N inputs have held the same values for `idleFrames` frames, e.g. the released voices of a poly sequencer.
+    By then everything derived from them (oversampling filters, trigger pulses, delays) has settled, so the outputs
+    already in the ports can be left as they are. Any change of input, or `wake()` for a change shared by all blocks,
+    makes the block active again at once.
+*/
+template <typename T, int N>
+struct TBlockActivity {
+	// ~43ms at 48kHz, longer than the oversampling filters take to settle and the 1ms trigger pulses at any sample rate
+	static constexpr int idleFrames = 2048;
+	T last[N] = {};
+	int constantFrames = 0;
+
+	void wake() {
+		constantFrames = 0;
+	}
+
+	/** Copies the inputs of the first `numLanes` channels from a block of another SIMD width, and wakes this one */
+	template <typename U>
+	void copyLanes(const TBlockActivity<U, N>& from, int numLanes) {
+		for (int k = 0; k < N; k++) {
+			for (int l = 0; l < numLanes; l++) {
+				last[k][l] = from.last[k][l];
+			}
+		}
+		wake();
+	}
+
+	/** Returns whether the block needs processing this frame, given its inputs */
+	bool process(const T* in) {
+		bool changed = false;
+		for (int k = 0; k < N; k++) {
+			changed |= differs(in[k], last[k]);
+			last[k] = in[k];
+		}
+		if (changed) {
+			constantFrames = 0;
+			return true;
+		}
+		if (constantFrames < idleFrames) {
+			constantFrames++;
+			return true;
+		}
+		return false;
+	}
+
+	static bool differs(double a, double b) {
+		return a != b;
+	}
+	template <typename U>
+	static bool differs(const U& a, const U& b) {
+		return movemask(a != b) != 0;
+	}
+};
+
+typedef TPulseGenerator<simd::float_4> PulseGenerator_4;
+typedef TBooleanTrigger<simd::float_4> BooleanTrigger_4;
+
 struct GoldPort : app::SvgPort {
 	GoldPort() {
 		setSvg(Svg::load(asset::plugin(pluginInstance, "res/components/GoldPort.svg")));